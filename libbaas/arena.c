@@ -0,0 +1,118 @@
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "baas/arena.h"
+
+typedef struct arena_block_t {
+  struct arena_block_t *next;
+  size_t size;  /* usable bytes */
+  size_t used;
+  max_align_t data[];
+} arena_block_t;
+
+struct arena_t {
+  arena_block_t *head;  /* current block */
+  arena_block_t *first; /* kept on reset */
+  size_t blksz;
+  size_t used;
+};
+
+#define ARENA_BLOCK_SZ 4096
+#define ARENA_ALIGN    (sizeof(max_align_t))
+
+static size_t arena_round(size_t size) {
+  return (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+}
+
+static arena_block_t * arena_block(size_t size) {
+  arena_block_t *b = (arena_block_t*)xmalloc(sizeof(arena_block_t) + size);
+  if (!b)
+    return NULL;
+  b->next = NULL;
+  b->size = size;
+  b->used = 0;
+  return b;
+}
+
+/*******************************************************/
+arena_t * arena_init(size_t blksz) {
+  arena_t *a = (arena_t*)zmalloc(sizeof(arena_t));
+  a->blksz = arena_round(blksz ? blksz : ARENA_BLOCK_SZ);
+  if (!(a->head = a->first = arena_block(a->blksz))) {
+    free(a);
+    return NULL;
+  }
+  return a;
+}
+
+void arena_destroy(arena_t *a) {
+  if (!a)
+    return;
+  while (a->head) {
+    arena_block_t *b = a->head;
+    a->head = b->next;
+    free(b);
+  }
+  free(a);
+}
+
+void * arena_alloc(arena_t *a, size_t size) {
+  if (!a)
+    return NULL;
+  size = arena_round(size ? size : 1);
+
+  arena_block_t *b = a->head;
+  if (b->used + size > b->size) {
+    if (!(b = arena_block(size > a->blksz ? size : a->blksz)))
+      return NULL;
+    if (size > a->blksz && a->head->used < a->head->size) {
+      /* oversized: keep allocating from the current block */
+      b->next = a->head->next;
+      a->head->next = b;
+    } else {
+      b->next = a->head;
+      a->head = b;
+    }
+  }
+  void *r = (char*)b->data + b->used;
+  b->used += size;
+  a->used += size;
+  return r;
+}
+
+void * arena_zalloc(arena_t *a, size_t size) {
+  void *r = arena_alloc(a, size);
+  if (r)
+    memset(r, 0, size);
+  return r;
+}
+
+char * arena_strndup(arena_t *a, const char *s, size_t n) {
+  char *r = (char*)arena_alloc(a, n + 1);
+  if (r) {
+    memcpy(r, s, n);
+    r[n] = '\0';
+  }
+  return r;
+}
+
+void arena_reset(arena_t *a) {
+  if (!a)
+    return;
+  while (a->head) {
+    arena_block_t *b = a->head;
+    a->head = b->next;
+    if (b != a->first)
+      free(b);
+  }
+  a->head = a->first;
+  a->head->next = NULL;
+  a->head->used = 0;
+  a->used = 0;
+}
+
+size_t arena_used(const arena_t *a) {
+  return a ? a->used : 0;
+}
+
+/* vim: set sw=2 sts=2 : */
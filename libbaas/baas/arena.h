@@ -0,0 +1,28 @@
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include "common.h"
+
+/* bump allocator: allocations are only released all at once */
+typedef struct arena_t arena_t;
+
+/* constructor / destructor (blksz 0 picks a default block size) */
+arena_t * arena_init(size_t blksz);
+void arena_destroy(arena_t *a);
+
+/* get size bytes aligned for any type, requests larger than the block
+ * size get a block of their own */
+void * arena_alloc(arena_t *a, size_t size);
+/* same as alloc but zeroed */
+void * arena_zalloc(arena_t *a, size_t size);
+/* copy n bytes of s into the arena adding a terminating nul */
+char * arena_strndup(arena_t *a, const char *s, size_t n);
+
+/* release every allocation but keep the first block around for reuse */
+void arena_reset(arena_t *a);
+/* bytes handed out since init or the last reset */
+size_t arena_used(const arena_t *a);
+
+#endif /* _ARENA_H_ */
+
+/* vim: set sw=2 sts=2 : */
@@ -1,6 +1,7 @@
 #ifndef _GNU_SOURCE
 #define _GNU_SOURCE
 #endif
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -329,16 +330,26 @@ size_t djb_hash(const char *key) {
 }
 
 /* http://home.comcast.net/~bretm/hash/10.html */
-#define unlikely(x) __builtin_expect(!!(x), 0)
-size_t sbox_hash(const char *key) {
-  static size_t subst_box[256];
-  /* the first time the function is called it will initialize
-   * the static substition data and make it available for later use */
-  if (unlikely(subst_box[0] == 0)) {
-    srandom(1);
-    for (size_t hash = 0; hash < 256; hash++)
-      subst_box[hash] = random();
+static size_t subst_box[256];
+static pthread_once_t subst_once = PTHREAD_ONCE_INIT;
+
+/* same sequence as srandom(1) but on a private state, so neither the
+ * caller's random() sequence nor concurrent callers are disturbed */
+static void sbox_init(void) {
+  static char state[128];
+  struct random_data buf;
+  int32_t r;
+  memset(&buf, 0, sizeof(buf));
+  initstate_r(1, state, sizeof(state), &buf);
+  for (size_t hash = 0; hash < 256; hash++) {
+    random_r(&buf, &r);
+    subst_box[hash] = r;
   }
+}
+
+size_t sbox_hash(const char *key) {
+  /* the first call initializes the static substition data */
+  pthread_once(&subst_once, sbox_init);
   size_t hash = 0;
   while (*key != '\0')
     hash = 3 * (hash ^ subst_box[(unsigned char)*key++]);
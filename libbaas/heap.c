@@ -178,7 +178,7 @@ heap_t * heap_heapify(void *data, size_t n, size_t sz,
   for (i = 0; i < (ssize_t)n; i++)
     h->data[i] = ((char*)data + i*sz);
   /* sift down every element starting from the last parent */
-  for (i = heap_parent(n); i >= 0; i--)
+  for (i = n ? (ssize_t)heap_parent(n) : -1; i >= 0; i--)
     heap_sift_down(h, h->data[i], i);
   return h;
 }
@@ -0,0 +1,60 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+#include "baas/arena.h"
+
+void check_alloc(void) {
+  arena_t *a = arena_init(256);
+  char *p[1000];
+  size_t i, j;
+
+  for (i = 0; i < 1000; i++) {
+    p[i] = (char*)arena_alloc(a, i % 37);
+    assert(p[i] != NULL);
+    assert((uintptr_t)p[i] % sizeof(long double) == 0);
+    memset(p[i], i & 0xff, i % 37);
+  }
+  /* allocations don't overlap */
+  for (i = 0; i < 1000; i++)
+    for (j = 0; j < i % 37; j++)
+      assert(p[i][j] == (char)(i & 0xff));
+
+  /* larger than a block */
+  long double *big = (long double*)arena_zalloc(a, 4096 * sizeof(long double));
+  for (i = 0; i < 4096; i++)
+    assert(big[i] == 0.0);
+  /* and the current block is still in use after it */
+  char *small = (char*)arena_alloc(a, 8);
+  assert(small != NULL);
+
+  char *s = arena_strndup(a, "hello world", 5);
+  assert(!strcmp(s, "hello"));
+  assert(arena_used(a) > 4096 * sizeof(long double));
+
+  arena_reset(a);
+  assert(arena_used(a) == 0);
+  assert(arena_alloc(a, 16) != NULL);
+  arena_destroy(a);
+}
+
+void check_reset(void) {
+  arena_t *a = arena_init(0);
+  size_t i, j;
+  for (j = 0; j < 100; j++) {
+    for (i = 0; i < 100; i++)
+      *(int*)arena_alloc(a, sizeof(int) * (i + 1)) = i;
+    arena_alloc(a, 100000);
+    arena_reset(a);
+  }
+  arena_destroy(a);
+}
+
+int main(void) {
+  check_alloc();
+  check_reset();
+  return 0;
+}
+
+/* vim: set sw=2 sts=2 : */
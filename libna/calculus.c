@@ -1,5 +1,12 @@
+#include <float.h>
 #include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
+#include "baas/heap.h"
 #include "na/calculus.h"
 #include "na/interpolation.h"
 
@@ -63,32 +70,350 @@ long double integrate_simpson(function_t *f, long double x0, long double x1) {
 }
 
 
+/* levels of romberg's table, level k samples 2^k + 1 points */
+#define ROMBERG_MIN_LEVEL 4
+#define ROMBERG_MAX_LEVEL 24
+#define ROMBERG_EPSILON   1.0e-13L
+
+/* each level halves the trapezoids of the previous one, only the new
+ * midpoints are evaluated. The rows of the table extrapolate them with
+ * richardson, R(k, j) = R(k, j-1) + (R(k, j-1) - R(k-1, j-1)) / (4^j - 1) */
+long double integrate_romberg(function_t *f, long double x0, long double x1) {
+  long double prev[ROMBERG_MAX_LEVEL + 1], cur[ROMBERG_MAX_LEVEL + 1];
+  long double hw = x1 - x0, f0, f1, s, sabs, tabs, p4;
+  size_t j, k, n = 1;
+
+  f0 = function_eval(f, x0);
+  f1 = function_eval(f, x1);
+  prev[0] = hw * (f0 + f1) / 2.0;
+  /* trapezoids of |f| scale the tolerance when the integral cancels out */
+  tabs = fabsl(hw) * (fabsl(f0) + fabsl(f1)) / 2.0;
+
+  for (k = 1; k <= ROMBERG_MAX_LEVEL; k++) {
+    hw /= 2.0;
+    for (j = 0, s = sabs = 0.0; j < n; j++) {
+      long double y = function_eval(f, x0 + (2*j + 1) * hw);
+      s += y;
+      sabs += fabsl(y);
+    }
+    n *= 2;
+    cur[0] = prev[0] / 2.0 + hw * s;
+    tabs = tabs / 2.0 + fabsl(hw) * sabs;
+
+    for (j = 1, p4 = 4.0; j <= k; j++, p4 *= 4.0)
+      cur[j] = cur[j-1] + (cur[j-1] - prev[j-1]) / (p4 - 1.0);
+
+    if (k >= ROMBERG_MIN_LEVEL &&
+        fabsl(cur[k] - prev[k-1]) <= ROMBERG_EPSILON * fmaxl(fabsl(cur[k]), tabs))
+      return cur[k];
+    memcpy(prev, cur, sizeof(long double) * (k + 1));
+  }
+  return prev[ROMBERG_MAX_LEVEL];
+}
+
+
+/* kronrod nodes on [0, 1], the odd ones are the 7 point gauss nodes */
+static const long double gk_x[8] = {
+  0.991455371120812639206854697526329L, 0.949107912342758524526189684047851L,
+  0.864864423359769072789712788640926L, 0.741531185599394439863864773280788L,
+  0.586087235467691130294144845693013L, 0.405845151377397166906606412076961L,
+  0.207784955007898467600689403773245L, 0.0L,
+};
+static const long double gk_wk[8] = {
+  0.022935322010529224963732008058970L, 0.063092092629978553290700663189204L,
+  0.104790010322250183839876322541518L, 0.140653259715525918745189590510238L,
+  0.169004726639267902826583426598550L, 0.190350578064785409913256402421014L,
+  0.204432940075298892414161999234649L, 0.209482141084727828012999174891714L,
+};
+static const long double gk_wg[4] = {
+  0.129484966168869693270611432679082L, 0.279705391489276667901467771423780L,
+  0.381830050505118944950369775488975L, 0.417959183673469387755102040816327L,
+};
+
+typedef struct {
+  long double x0, x1;
+  long double r, err;
+} panel_t;
+
+/* 15 point kronrod estimate of the panel. Its error is the difference
+ * with the embedded 7 point gauss rule, scaled as in quadpack's qk15 */
+static void gk_panel(function_t *f, panel_t *p) {
+  long double c = (p->x0 + p->x1) / 2.0, hw = (p->x1 - p->x0) / 2.0;
+  long double fv[15], k = 0.0, g = 0.0, kabs = 0.0, kasc = 0.0;
+  int j;
+
+  fv[14] = function_eval(f, c);
+  for (j = 0; j < 7; j++) {
+    fv[2*j] = function_eval(f, c - hw * gk_x[j]);
+    fv[2*j+1] = function_eval(f, c + hw * gk_x[j]);
+  }
+  for (j = 0; j < 15; j++) {
+    long double w = gk_wk[j < 14 ? j / 2 : 7];
+    k += w * fv[j];
+    kabs += w * fabsl(fv[j]);
+    /* gauss nodes are the odd kronrod ones and the center */
+    if (j == 14)
+      g += gk_wg[3] * fv[j];
+    else if ((j / 2) & 1)
+      g += gk_wg[j / 4] * fv[j];
+  }
+  for (j = 0; j < 15; j++)
+    kasc += gk_wk[j < 14 ? j / 2 : 7] * fabsl(fv[j] - k / 2.0);
+
+  hw = fabsl(hw);
+  p->r = k * (p->x1 < p->x0 ? -hw : hw);
+  p->err = fabsl(k - g) * hw;
+  kasc *= hw;
+  kabs *= hw;
+  if (kasc != 0.0 && p->err != 0.0)
+    p->err = kasc * fminl(1.0, powl(200.0 * p->err / kasc, 1.5));
+  /* don't ask for more than the evaluations can give */
+  if (kabs > LDBL_MIN / (50.0 * LDBL_EPSILON))
+    p->err = fmaxl(50.0 * LDBL_EPSILON * kabs, p->err);
+}
+
+static int panel_cmp(const void *a, const void *b) {
+  long double ea = ((const panel_t*)a)->err, eb = ((const panel_t*)b)->err;
+  return ea < eb ? -1 : ea > eb;
+}
+
+int integrate_gk(function_t *f, long double x0, long double x1,
+                 long double abserr, long double relerr,
+                 long double *r, long double *err, size_t *evals) {
+  panel_t *panels = (panel_t*)zmalloc(sizeof(panel_t) * INTEGRATE_MAX_PANELS);
+  heap_t *q = heap_init(NULL, panel_cmp);
+  long double total, e;
+  size_t i, n = 1;
+  int ret = 0;
+
+  panels[0].x0 = x0;
+  panels[0].x1 = x1;
+  gk_panel(f, &panels[0]);
+  heap_insert(q, &panels[0]);
+  total = panels[0].r;
+  e = panels[0].err;
+
+  /* split the worst panel in two, stop once they're all good enough */
+  while (e > abserr && e > relerr * fabsl(total)) {
+    if (n + 2 > INTEGRATE_MAX_PANELS) {
+      ret = 1;
+      break;
+    }
+    panel_t *p = (panel_t*)heap_pop(q), *a = &panels[n++], *b = &panels[n++];
+    long double m = (p->x0 + p->x1) / 2.0;
+    a->x0 = p->x0; a->x1 = m;
+    b->x0 = m; b->x1 = p->x1;
+    gk_panel(f, a);
+    gk_panel(f, b);
+    total += a->r + b->r - p->r;
+    e += a->err + b->err - p->err;
+    heap_insert(q, a);
+    heap_insert(q, b);
+    /* the interval can't be split any further */
+    if (m == p->x0 || m == p->x1) {
+      ret = 1;
+      break;
+    }
+  }
+
+  /* add the live panels again, the running sums drift */
+  total = e = 0.0;
+  for (i = 0; i < heap_size(q); i++) {
+    const panel_t *p = (const panel_t*)heap_get(q, i);
+    total += p->r;
+    e += p->err;
+  }
+
+  *r = total;
+  if (err)
+    *err = e;
+  if (evals)
+    *evals = 15 * n;
+  heap_destroy(q);
+  free(panels);
+  return ret;
+}
+
+
+typedef struct {
+  const function_t *f;
+  long double x0, x1, abserr, relerr;
+  long double r[INTEGRATE_CHUNKS], err[INTEGRATE_CHUNKS];
+  size_t evals[INTEGRATE_CHUNKS];
+  int ret[INTEGRATE_CHUNKS];
+  atomic_size_t next;
+} chunk_job_t;
+
+static void * integrate_worker(void *arg) {
+  chunk_job_t *job = (chunk_job_t*)arg;
+  function_t *f = function_clone(job->f);
+  long double w = (job->x1 - job->x0) / INTEGRATE_CHUNKS;
+  size_t i;
+
+  while ((i = atomic_fetch_add(&job->next, 1)) < INTEGRATE_CHUNKS) {
+    /* the last chunk ends exactly at x1 */
+    long double a = job->x0 + i * w,
+                b = i + 1 == INTEGRATE_CHUNKS ? job->x1 : job->x0 + (i + 1) * w;
+    job->ret[i] = integrate_gk(f, a, b, job->abserr / INTEGRATE_CHUNKS, job->relerr,
+                               &job->r[i], &job->err[i], &job->evals[i]);
+  }
+  function_destroy(f);
+  return NULL;
+}
+
+int integrate_parallel(function_t *f, long double x0, long double x1,
+                       long double abserr, long double relerr, size_t nthreads,
+                       long double *r, long double *err, size_t *evals) {
+  chunk_job_t *job = (chunk_job_t*)zmalloc(sizeof(chunk_job_t));
+  job->f = f;
+  job->x0 = x0;
+  job->x1 = x1;
+  job->abserr = abserr;
+  job->relerr = relerr;
+  atomic_init(&job->next, 0);
+
+  if (nthreads == 0) {
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    nthreads = ncpu > 0 ? ncpu : 1;
+  }
+  if (nthreads > INTEGRATE_CHUNKS)
+    nthreads = INTEGRATE_CHUNKS;
+
+  /* the calling thread is one of the workers */
+  pthread_t threads[INTEGRATE_CHUNKS];
+  size_t i, started = 0;
+  for (i = 1; i < nthreads; i++)
+    if (pthread_create(&threads[started], NULL, integrate_worker, job) == 0)
+      started++;
+  integrate_worker(job);
+  for (i = 0; i < started; i++)
+    pthread_join(threads[i], NULL);
+
+  /* neumaier summation in chunk order */
+  long double sum = 0.0, c = 0.0, e = 0.0;
+  size_t n = 0;
+  int ret = 0;
+  for (i = 0; i < INTEGRATE_CHUNKS; i++) {
+    long double t = sum + job->r[i];
+    if (fabsl(sum) >= fabsl(job->r[i]))
+      c += (sum - t) + job->r[i];
+    else
+      c += (job->r[i] - t) + sum;
+    sum = t;
+    e += job->err[i];
+    n += job->evals[i];
+    ret |= job->ret[i];
+  }
+
+  *r = sum + c;
+  if (err)
+    *err = e;
+  if (evals)
+    *evals = n;
+  free(job);
+  return ret;
+}
+
+
 /*
  *     /x1
  * l = | sqrt(1 + f'(x)^2)dx
  *     /x0
- * Compute the arc-length using composite simpson's rule
+ * [x0, x1] is split in segments that are integrated with simpson's rule
+ * on grids of samples of f, f' comes from the five point stencil over the
+ * same grid (one sided at x0 and x1, f may not be defined past them). A
+ * segment's grid is refined by halving its step, reusing the samples taken
+ * so far, until the length stops changing, so each segment gets the step
+ * its curvature needs.
  */
-long double arc_length(function_t *f, long double x0, long double x1) {
-  int j, n = (int)((x1 - x0) / 0.3e-2);
-  long double _h = (x1 - x0) / (2.0 * n);
-  long double p0, pm, pi = 0.0, pj = 0.0;
+#define ARC_SEGMENTS  8
+#define ARC_MIN_STEPS 8
+#define ARC_MAX_STEPS (1 << 16)
+#define ARC_EPSILON   1.0e-9L
 
-  p0 = derivate_1(f, x0);
-  p0 = sqrtl(1.0 + p0 * p0);
-  pm = derivate_1(f, x1);
-  pm = sqrtl(1.0 + pm * pm);
+/* segment ends that are ends of [x0, x1], f isn't sampled past them */
+#define ARC_LO 1
+#define ARC_HI 2
 
-  for (j = 1; j < n; j++) {
-    long double d = derivate_1(f, x0 + _h * (2*j));
-    pj += sqrtl(1.0 + d * d);
-  }
-  for (j = 1; j <= n; j++) {
-    long double d = derivate_1(f, x0 + _h * (2*j-1));
-    pi += sqrtl(1.0 + d * d);
+/* f'(a + k * step) from a grid y[k] = f(a + (k-2) * step) of n steps,
+ * the stencil leans inwards at the outer ends */
+static long double arc_slope(const long double *y, size_t k, size_t n, int edges,
+                             long double step) {
+  const long double *c = y + k + 2;
+  long double d;
+  if ((edges & ARC_LO) && k == 0)
+    d = -25.0 * c[0] + 48.0 * c[1] - 36.0 * c[2] + 16.0 * c[3] - 3.0 * c[4];
+  else if ((edges & ARC_LO) && k == 1)
+    d = -3.0 * c[-1] - 10.0 * c[0] + 18.0 * c[1] - 6.0 * c[2] + c[3];
+  else if ((edges & ARC_HI) && k == n)
+    d = 25.0 * c[0] - 48.0 * c[-1] + 36.0 * c[-2] - 16.0 * c[-3] + 3.0 * c[-4];
+  else if ((edges & ARC_HI) && k == n - 1)
+    d = 3.0 * c[1] + 10.0 * c[0] - 18.0 * c[-1] + 6.0 * c[-2] - c[-3];
+  else
+    d = c[-2] - 8.0 * c[-1] + 8.0 * c[1] - c[2];
+  return d / (12.0 * step);
+}
+
+/* simpson over the n steps of the grid */
+static long double arc_simpson(const long double *y, size_t n, int edges,
+                               long double step) {
+  long double s = 0.0;
+  size_t k;
+  for (k = 0; k <= n; k++) {
+    long double d = arc_slope(y, k, n, edges, step);
+    s += (k == 0 || k == n ? 1.0 : (k & 1) ? 4.0 : 2.0) * sqrtl(1.0 + d * d);
   }
+  return fabsl(s * step / 3.0);
+}
 
-  return (p0 + 2.0 * pj + 4.0 * pi + pm) * _h / 3.0;
+/* k-th point of the grid, 0 for those beyond an outer end */
+static long double arc_sample(function_t *f, long double a, long double step,
+                              size_t k, size_t n, int edges) {
+  if (((edges & ARC_LO) && k < 2) || ((edges & ARC_HI) && k > n + 2))
+    return 0.0;
+  return function_eval(f, a + ((long double)k - 2.0) * step);
+}
+
+static long double arc_segment(function_t *f, long double a, long double b,
+                               int edges, long double eps) {
+  size_t n = ARC_MIN_STEPS, k;
+  long double step = (b - a) / n, l, prev;
+  long double *y = (long double*)zmalloc(sizeof(long double) * (n + 5)), *y2;
+
+  for (k = 0; k < n + 5; k++)
+    y[k] = arc_sample(f, a, step, k, n, edges);
+  l = arc_simpson(y, n, edges, step);
+
+  do {
+    /* the even points of the finer grid were sampled already */
+    y2 = (long double*)zmalloc(sizeof(long double) * (2 * n + 5));
+    for (k = 0; k <= n + 2; k++)
+      y2[2*k] = y[k+1];
+    step /= 2.0;
+    for (k = 1; k < 2 * n + 5; k += 2)
+      y2[k] = arc_sample(f, a, step, k, 2 * n, edges);
+    free(y);
+    y = y2;
+    n *= 2;
+    prev = l;
+    l = arc_simpson(y, n, edges, step);
+  } while (fabsl(l - prev) > 15.0 * eps * l && n < ARC_MAX_STEPS);
+
+  free(y);
+  /* richardson, simpson's error shrinks 16 times per halving */
+  return l + (l - prev) / 15.0;
+}
+
+long double arc_length(function_t *f, long double x0, long double x1) {
+  long double w = (x1 - x0) / ARC_SEGMENTS, l = 0.0;
+  int j;
+  if (x0 == x1)
+    return 0.0;
+  for (j = 0; j < ARC_SEGMENTS; j++)
+    l += arc_segment(f, x0 + j * w, j + 1 == ARC_SEGMENTS ? x1 : x0 + (j + 1) * w,
+                     (j == 0 ? ARC_LO : 0) | (j + 1 == ARC_SEGMENTS ? ARC_HI : 0),
+                     ARC_EPSILON);
+  return l;
 }
 
 /* vim: set sw=2 sts=2 : */
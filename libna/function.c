@@ -1,17 +1,33 @@
+#include <math.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "na/function.h"
 #include "parser/parser.h"
+#include "parser/profile.h"
+
+typedef struct {
+  long double x, y;
+  int valid;
+} memo_entry_t;
 
 struct function_t {
   expr_t *expr;
   hashtbl_t *vars;
+  hashtbl_t *ivars;   /* created on the first interval evaluation */
+  /* direct mapped evaluation cache */
+  memo_entry_t *memo;
+  size_t memo_mask;
+  size_t hits, misses;
 };
 
 function_t * function_create(const char *func) {
   function_t *f = zmalloc(sizeof(function_t));
-  f->expr = parser_compile_str(func);
+  if (!(f->expr = parser_compile_str(func))) {
+    free(f);
+    return NULL;
+  }
   f->vars = hashtbl_init(free, NULL);
   return f;
 }
@@ -20,11 +36,33 @@ void function_destroy(function_t *f) {
   if (!f)
     return;
   hashtbl_destroy(f->vars);
+  if (f->ivars)
+    hashtbl_destroy(f->ivars);
   parser_destroy_expr(f->expr);
+  free(f->memo);
   free(f);
 }
 
-long double function_eval(function_t *f, long double x0) {
+function_t * function_clone(const function_t *f) {
+  function_t *c = zmalloc(sizeof(function_t));
+  c->expr = parser_copy_expr(f->expr);
+  c->vars = hashtbl_init(free, NULL);
+  /* values of the variables set on f (eg: parameters) */
+  char **keys;
+  size_t i, n = hashtbl_keys(f->vars, &keys);
+  for (i = 0; i < n; i++) {
+    long double *v = zmalloc(sizeof(long double));
+    *v = *(long double*)hashtbl_get(f->vars, keys[i]);
+    hashtbl_insert(c->vars, keys[i], v);
+    free(keys[i]);
+  }
+  free(keys);
+  if (f->memo)
+    function_memoize(c, f->memo_mask + 1);
+  return c;
+}
+
+static long double function_eval_expr(function_t *f, long double x0) {
   long double *x = hashtbl_get(f->vars, "x");
   if (!x) {
     x = zmalloc(sizeof(long double));
@@ -37,4 +75,117 @@ long double function_eval(function_t *f, long double x0) {
   return x0;
 }
 
+long double * function_param(function_t *f, const char *name) {
+  long double *v = hashtbl_get(f->vars, name);
+  if (!v) {
+    v = zmalloc(sizeof(long double));
+    hashtbl_insert(f->vars, name, v);
+  }
+  return v;
+}
+
+ssize_t function_polynomial(const function_t *f, long double **coef) {
+  const char *var;
+  long double *c;
+  ssize_t n = parser_polynomial(f->expr, &var, &c);
+  if (n < 0)
+    return -1;
+  /* constants are polynomials in any variable */
+  if (var && strcmp(var, "x")) {
+    free(c);
+    return -1;
+  }
+  if (coef)
+    *coef = c;
+  else
+    free(c);
+  return n;
+}
+
+int function_eval_interval(function_t *f, ival_t x, ival_t *r) {
+  if (!f->ivars)
+    f->ivars = hashtbl_init(free, NULL);
+  ival_t *ix = hashtbl_get(f->ivars, "x");
+  if (!ix) {
+    ix = zmalloc(sizeof(ival_t));
+    hashtbl_insert(f->ivars, "x", ix);
+  }
+  *ix = x;
+
+  /* the other variables (eg: parameters) hold a single value */
+  char **keys;
+  size_t i, n = hashtbl_keys(f->vars, &keys);
+  for (i = 0; i < n; i++) {
+    if (strcmp(keys[i], "x")) {
+      ival_t *iv = hashtbl_get(f->ivars, keys[i]);
+      if (!iv) {
+        iv = zmalloc(sizeof(ival_t));
+        hashtbl_insert(f->ivars, keys[i], iv);
+      }
+      iv->lo = iv->hi = *(long double*)hashtbl_get(f->vars, keys[i]);
+    }
+    free(keys[i]);
+  }
+  free(keys);
+  return parser_eval_interval(f->expr, r, f->ivars);
+}
+
+/* mix the bits of x into a cache slot */
+static size_t memo_slot(const function_t *f, long double x) {
+  double d = (double)x;
+  uint64_t bits;
+  memcpy(&bits, &d, sizeof(bits));
+  bits *= 0x9e3779b97f4a7c15ull;
+  return (size_t)(bits >> 32) & f->memo_mask;
+}
+
+static long double function_eval_memo(function_t *f, long double x0) {
+  if (!f->memo)
+    return function_eval_expr(f, x0);
+
+  memo_entry_t *m = &f->memo[memo_slot(f, x0)];
+  /* signbit tells 0.0 and -0.0 apart, NaNs never hit */
+  if (m->valid && m->x == x0 && signbit(m->x) == signbit(x0)) {
+    f->hits++;
+    return m->y;
+  }
+  f->misses++;
+  m->x = x0;
+  m->y = function_eval_expr(f, x0);
+  m->valid = 1;
+  return m->y;
+}
+
+long double function_eval(function_t *f, long double x0) {
+#ifdef _PROFILE_
+  uint64_t t0 = parser_profile_clock();
+  long double y = function_eval_memo(f, x0);
+  parser_profile_call(f->expr, parser_profile_clock() - t0);
+  return y;
+#else
+  return function_eval_memo(f, x0);
+#endif
+}
+
+void function_memoize(function_t *f, size_t size) {
+  size_t n = 1;
+  free(f->memo);
+  f->memo = NULL;
+  f->memo_mask = 0;
+  f->hits = f->misses = 0;
+  if (size == 0)
+    return;
+  while (n < size)
+    n <<= 1;
+  f->memo = (memo_entry_t*)zmalloc(sizeof(memo_entry_t) * n);
+  f->memo_mask = n - 1;
+}
+
+void function_memo_stats(const function_t *f, size_t *hits, size_t *misses) {
+  if (hits)
+    *hits = f->hits;
+  if (misses)
+    *misses = f->misses;
+}
+
 /* vim: set sw=2 sts=2 : */
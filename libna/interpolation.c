@@ -1,3 +1,8 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "baas/common.h"
+
 #include "na/interpolation.h"
 #include "na/combinatorics.h"
 
@@ -17,20 +22,87 @@
  *        i=0                  j=0
  * */
 
-int interpolate_newton(vector2_t *x, int n, long double x0, long double *r) {
-  long double a;
-  int i, j;
+struct newton_poly_t {
+  size_t n;
+  long double *x;     /* abscissas */
+  long double *c;     /* c[i] = f[x0, ..., xi] */
+};
+
+newton_poly_t * newton_poly_create(const vector2_t *x, size_t n) {
+  size_t i, j;
+
+  for (i = 0; i < n; i++)
+    for (j = 0; j < i; j++)
+      if (x[i].x0 == x[j].x0) {
+        fprintf(stderr, "interpolation points %zu and %zu share x\n", j, i);
+        return NULL;
+      }
+
+  newton_poly_t *p = (newton_poly_t*)zmalloc(sizeof(newton_poly_t));
+  p->n = n;
+  p->x = (long double*)zmalloc(sizeof(long double) * (2 * n + 1));
+  p->c = p->x + n;
+  for (i = 0; i < n; i++) {
+    p->x[i] = x[i].x0;
+    p->c[i] = x[i].x1;
+  }
+
+  /* a column of the table at a time, from the bottom so that c[j-1]
+   * still holds the previous column */
+  for (i = 1; i < n; i++)
+    for (j = n - 1; j >= i; j--)
+      p->c[j] = (p->c[j] - p->c[j-1]) / (p->x[j] - p->x[j-i]);
+  return p;
+}
 
-  for (i = 0, *r = 0.0, a = 1.0; i < n; i++) {
+void newton_poly_destroy(newton_poly_t *p) {
+  if (!p)
+    return;
+  free(p->x);
+  free(p);
+}
+
+size_t newton_poly_coef(const newton_poly_t *p, const long double **c) {
+  if (c)
+    *c = p->c;
+  return p->n;
+}
+
+/* nested multiplication:
+ * N(x) = c0 + (x - x0) * (c1 + (x - x1) * (c2 + ...)) */
+long double newton_poly_eval(const newton_poly_t *p, long double x0) {
+  size_t i = p->n;
+  long double r;
+
+  if (i == 0)
+    return 0.0;
+  for (r = p->c[--i]; i-- > 0;)
+    r = r * (x0 - p->x[i]) + p->c[i];
+  return r;
+}
 
-    /* x[i].x1 = f[x0, ..., xi]: devided difference */
-    for (j = i; j < n && j > 0; j++)
-      x[j].x1 = (x[j].x1 - x[j-1].x1) / (x[j].x0 - x[j-i].x0);
+void newton_poly_eval_n(const newton_poly_t *p, const long double *x, size_t n,
+                        long double *r) {
+  size_t i, k, b;
 
-    *r += x[i].x1 * a;
-    a *= x0 - x[i].x0; /* (x - x0) * ... * (x - xi) */
+  /* points of a block are independent, interleaving them keeps the
+   * multiply-add chains from waiting on each other */
+  for (b = 0; b < n; b += NEWTON_POLY_BLOCK) {
+    size_t m = n - b < NEWTON_POLY_BLOCK ? n - b : NEWTON_POLY_BLOCK;
+    for (k = 0; k < m; k++)
+      r[b + k] = p->n ? p->c[p->n - 1] : 0.0;
+    for (i = p->n ? p->n - 1 : 0; i-- > 0;)
+      for (k = 0; k < m; k++)
+        r[b + k] = r[b + k] * (x[b + k] - p->x[i]) + p->c[i];
   }
-  /* x[i].x1 have now f[x0, ..., xi] */
+}
+
+int interpolate_newton(vector2_t *x, int n, long double x0, long double *r) {
+  newton_poly_t *p = newton_poly_create(x, n > 0 ? n : 0);
+  if (!p)
+    return 1;
+  *r = newton_poly_eval(p, x0);
+  newton_poly_destroy(p);
   return 0;
 }
 
@@ -12,6 +12,31 @@ long double derivate(function_t *f, int n, long double x0);
 /* integrate f between x0 and x1 using simpson */
 long double integrate_simpson(function_t *f, long double x0, long double x1);
 
+/* romberg integration of f between x0 and x1 for smooth integrands: the
+ * panels double until the extrapolated estimates agree, every sample is
+ * evaluated once */
+long double integrate_romberg(function_t *f, long double x0, long double x1);
+
+/* adaptive gauss-kronrod (7-15) integration of f between x0 and x1, the
+ * panel with the largest error is split until the error estimate is below
+ * max(abserr, relerr * |r|). err and evals (may be NULL) get the estimate
+ * and the number of evaluations of f. return 0 on success, 1 if the
+ * panels ran out before reaching the tolerance */
+#define INTEGRATE_MAX_PANELS 4096
+int integrate_gk(function_t *f, long double x0, long double x1,
+                 long double abserr, long double relerr,
+                 long double *r, long double *err, size_t *evals);
+
+/* integrate_gk over INTEGRATE_CHUNKS equal chunks of [x0, x1] spread over
+ * nthreads workers (0: one per cpu), each with its own clone of f. Chunk
+ * i must be within max(abserr / INTEGRATE_CHUNKS, relerr * |r_i|). The
+ * chunks are added in order, so r doesn't depend on the number of threads.
+ * return 0 on success, 1 if a chunk didn't reach its tolerance */
+#define INTEGRATE_CHUNKS 64
+int integrate_parallel(function_t *f, long double x0, long double x1,
+                       long double abserr, long double relerr, size_t nthreads,
+                       long double *r, long double *err, size_t *evals);
+
 /* calculate the length of an arc described by f */
 long double arc_length(function_t *f, long double x0, long double x1);
 
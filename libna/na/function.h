@@ -1,11 +1,35 @@
 #ifndef _FUNCTION_H_
 #define _FUNCTION_H_
 
+#include <sys/types.h>
+
+#include "parser/interval.h"
+
 typedef struct function_t function_t;
 
+/* compile func (a function of x), NULL if it doesn't compile */
 function_t * function_create(const char *func);
 void function_destroy(function_t *f);
+/* a copy of f with its own expression and variables, so it can be
+ * evaluated in another thread. The cache size carries over, not its contents */
+function_t * function_clone(const function_t *f);
 long double function_eval(function_t *f, long double x0);
+/* storage for the value of variable name in f, it's created (as 0) if
+ * missing and stays valid until f is destroyed. The cache is keyed on x
+ * only, it must be disabled while parameters change */
+long double * function_param(function_t *f, const char *name);
+/* if f is a polynomial in x return its degree and coef gets the
+ * coefficients lowest degree first (user must free), -1 otherwise */
+ssize_t function_polynomial(const function_t *f, long double **coef);
+/* enclosure of f over x, see parser_eval_interval. return 0 on success */
+int function_eval_interval(function_t *f, ival_t x, ival_t *r);
+
+/* opt-in cache of the last evaluations keyed on the exact value of x,
+ * only valid for functions without side effects (eg: not using random).
+ * size is rounded up to a power of 2, 0 disables the cache */
+void function_memoize(function_t *f, size_t size);
+/* number of evaluations served from/missed by the cache */
+void function_memo_stats(const function_t *f, size_t *hits, size_t *misses);
 
 #endif /* _FUNCTION_H_ */
 
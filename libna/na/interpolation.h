@@ -4,6 +4,22 @@
 #include "natools.h"
 #include "function.h"
 
+/* newton's interpolation polynomial through the points (x0, x1) of x,
+ * the divided differences are worked out once and evaluating is O(n) */
+typedef struct newton_poly_t newton_poly_t;
+
+/* x isn't modified, NULL if two points share the same x0 */
+newton_poly_t * newton_poly_create(const vector2_t *x, size_t n);
+void newton_poly_destroy(newton_poly_t *p);
+/* c gets f[x0], f[x0,x1], ..., return their number */
+size_t newton_poly_coef(const newton_poly_t *p, const long double **c);
+long double newton_poly_eval(const newton_poly_t *p, long double x0);
+/* r[k] = N(x[k]) for the n points of x */
+#define NEWTON_POLY_BLOCK 64
+void newton_poly_eval_n(const newton_poly_t *p, const long double *x, size_t n,
+                        long double *r);
+
+/* N(x0) through the n points of x, return 1 if two points share x0 */
 int interpolate_newton(vector2_t *x, int n, long double x0, long double *r);
 long double finite_difference(function_t *f, int n, long double x0, long double h);
 int interpolate_lagrange(vector2_t *x, int n, long double x0, long double *r);
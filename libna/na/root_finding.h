@@ -1,15 +1,71 @@
 #ifndef _ROOT_SEARCH_H_
 #define _ROOT_SEARCH_H_
 
+#include <complex.h>
+
 #include "na/natools.h"
 #include "na/function.h"
 
 extern int root_search_verbose;
 
-int root_secant(function_t *f, interval_t *i, stop_cond_t *s, long double *r);
-int root_newton(function_t *f, long double x0, stop_cond_t *s, long double *r);
-int root_bisection(function_t *f, interval_t *i, stop_cond_t *s, long double *r);
-int root_regulafalsi(function_t *f, interval_t *i, stop_cond_t *s, long double *r);
+/* why a root search stopped */
+typedef enum {
+  rootConverged,      /* the stop condition was met */
+  rootMaxIterations,  /* ran out of iterations */
+  rootNoBracket       /* f doesn't change sign over the interval */
+} root_stop_t;
+
+/* outcome of a root search */
+typedef struct {
+  long double root;
+  long double residual;   /* f(root) */
+  long double width;      /* final bracket width (last step for newton) */
+  size_t iterations;
+  size_t evals;           /* evaluations of f, derivatives included */
+  root_stop_t reason;
+} root_result_t;
+
+/* open methods, return 0 (r->reason tells if they converged) */
+int root_secant(function_t *f, interval_t *i, stop_cond_t *s, root_result_t *r);
+int root_newton(function_t *f, long double x0, stop_cond_t *s, root_result_t *r);
+/* bracketing methods, return 0 or 3 if i doesn't bracket a root */
+int root_bisection(function_t *f, interval_t *i, stop_cond_t *s, root_result_t *r);
+int root_regulafalsi(function_t *f, interval_t *i, stop_cond_t *s, root_result_t *r);
+int root_brent(function_t *f, interval_t *i, stop_cond_t *s, root_result_t *r);
+
+/* find the roots of f in i: a grid of ROOT_SCAN_CELLS cells is sampled
+ * for sign changes, cells that don't change sign are halved (at most
+ * ROOT_SCAN_DEPTH times) unless the interval evaluation of f over them
+ * excludes 0. The brackets found are refined with brent's method across
+ * nthreads workers (0: one per cpu) using clones of f.
+ * roots gets them sorted (user must free), return their number or -1.
+ * Roots where f touches 0 without changing sign are only found if a
+ * sample hits them exactly, a run of zero samples is reported once */
+#define ROOT_SCAN_CELLS 256
+#define ROOT_SCAN_DEPTH 8
+ssize_t root_scan(function_t *f, interval_t *i, stop_cond_t *s, size_t nthreads,
+                  long double **roots);
+
+/* solve func = 0 (func of x and the variables in params) with brent's
+ * method for n sets of parameters: values holds nparams values per item
+ * and brackets an interval per item. func is compiled once, items advance
+ * in lockstep in blocks of ROOT_BATCH_LANES shared out to nthreads workers
+ * (0: one per cpu). Item k gets the same root root_brent would.
+ * results gets n items, return 0 or -1 if func doesn't compile */
+#define ROOT_BATCH_LANES 64
+int root_brent_batch(const char *func, const char *const *params, size_t nparams,
+                     const long double *values, const interval_t *brackets, size_t n,
+                     stop_cond_t *s, size_t nthreads, root_result_t *results);
+
+/* all the roots of coef[0] + coef[1]*x + ... + coef[n]*x**n at once
+ * (aberth's method), multiple roots are repeated. roots gets them sorted
+ * by real then imaginary part (user must free), return their number or -1
+ * if the polynomial is 0 or the roots don't converge within s */
+ssize_t root_polynomial(const long double *coef, size_t n, stop_cond_t *s,
+                        long double complex **roots);
+/* same for f, -1 if f isn't a polynomial in x */
+ssize_t root_polynomial_function(function_t *f, stop_cond_t *s,
+                                 long double complex **roots);
 
 #endif /* _ROOT_SEARCH_H_ */
 
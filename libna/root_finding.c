@@ -1,12 +1,35 @@
+#include <float.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <math.h>
 #include <stdio.h>
+#include <unistd.h>
+
+#include "baas/common.h"
 
 #include "na/root_finding.h"
 #include "na/calculus.h"
 
 int root_search_verbose = 0;
 
+/* derivate_1 samples f this many times */
+#define DERIVATE_1_EVALS 4
+
+static void root_result_init(root_result_t *r) {
+  r->root = NAN;
+  r->residual = NAN;
+  r->width = 0.0;
+  r->iterations = r->evals = 0;
+  r->reason = rootMaxIterations;
+}
+
+/* f at x, accounted in r */
+static long double root_eval(function_t *f, long double x, root_result_t *r) {
+  r->evals++;
+  return function_eval(f, x);
+}
+
 /*                 f(X_n)
  * X_n+1 = X_n - --------- (Newton's method)
  *                f'(X_n)
@@ -19,44 +42,56 @@ int root_search_verbose = 0;
  * X_n+1 = X_n - ------------------- * f(X_n)  (Secant method)
  *                f(X_n) - f(X_n-1)
  * */
-int root_secant(function_t *f, interval_t *i, stop_cond_t *s, long double *r) {
+int root_secant(function_t *f, interval_t *i, stop_cond_t *s, root_result_t *r) {
   long double d, f1, f0;
   size_t j;
 
-  f0 = function_eval(f, i->x0);
-  f1 = function_eval(f, i->x1);
+  root_result_init(r);
+  f0 = root_eval(f, i->x0, r);
+  f1 = root_eval(f, i->x1, r);
 
   for (j = 0; j < s->max_iterations; j++) {
     /* calculate next aproximation */
     d = f1 * (i->x1 - i->x0) / (f1 - f0);
     /* check stop condition */
-    if (fabsl(d) < s->epsilon) break;
+    if (fabsl(d) < s->epsilon) {
+      r->reason = rootConverged;
+      break;
+    }
 
     /* update secant points */
     i->x0 = i->x1; f0 = f1;
     i->x1 = i->x1 - d;
-    f1 = function_eval(f, i->x1);
+    f1 = root_eval(f, i->x1, r);
 
     if (root_search_verbose)
       fprintf(stderr, "i=%zu: x=%.15Lg f(x)=%.15Lg d=%.15Lg\n", j, i->x1, f1, d);
   }
 
   /* aproximate root */
-  *r = i->x1;
+  r->root = i->x1;
+  r->residual = f1;
+  r->width = fabsl(i->x1 - i->x0);
+  r->iterations = j;
   return 0;
 }
 
-int root_newton(function_t *f, long double x0, stop_cond_t *s, long double *r) {
-  long double f0, df0_dx, d;
+int root_newton(function_t *f, long double x0, stop_cond_t *s, root_result_t *r) {
+  long double f0 = 0.0, df0_dx, d = 0.0;
   size_t j;
 
+  root_result_init(r);
   for (j = 0; j < s->max_iterations; j++) {
     /* evaluate function at x0 */
-    f0 = function_eval(f, x0);
+    f0 = root_eval(f, x0, r);
     /* evaluate f'(x) at x0 */
     df0_dx = derivate_1(f, x0);
+    r->evals += DERIVATE_1_EVALS;
     /* check stop condition */
-    if (fabsl(d = f0 / df0_dx) < s->epsilon) break;
+    if (fabsl(d = f0 / df0_dx) < s->epsilon) {
+      r->reason = rootConverged;
+      break;
+    }
 
     x0 -= d;
 
@@ -64,7 +99,11 @@ int root_newton(function_t *f, long double x0, stop_cond_t *s, long double *r) {
       fprintf(stderr, "i=%zu: x=%.15Lg f(x)=%.15Lg d=%.15Lg\n", j, x0, f0, d);
   }
 
-  *r = x0;
+  r->root = x0;
+  /* the last step moved away from the last evaluation */
+  r->residual = r->reason == rootConverged ? f0 : root_eval(f, x0, r);
+  r->width = fabsl(d);
+  r->iterations = j;
   return 0;
 }
 
@@ -73,12 +112,13 @@ static void pair_swap(long double *x0, long double *x1) {
   *x0 = *x1; *x1 = m;
 }
 
-int root_bisection(function_t *f, interval_t *i, stop_cond_t *s, long double *r) {
-  long double m, fm, f1, f0;
+int root_bisection(function_t *f, interval_t *i, stop_cond_t *s, root_result_t *r) {
+  long double m, fm = 0.0, f1, f0;
   size_t j;
 
-  f0 = function_eval(f, i->x0);
-  f1 = function_eval(f, i->x1);
+  root_result_init(r);
+  f0 = root_eval(f, i->x0, r);
+  f1 = root_eval(f, i->x1, r);
 
   /* f(x0) and f(x1) have opposite signs => contain a root */
   if (f0 > 0.0 && f1 < 0.0) {
@@ -86,16 +126,20 @@ int root_bisection(function_t *f, interval_t *i, stop_cond_t *s, long double *r)
     pair_swap(&f0, &f1);
   } else if (!(f0 < 0.0 && f1 > 0.0)) {
     fprintf(stderr, "f(x0) * f(x1) !< 0\n");
+    r->reason = rootNoBracket;
     return 3;
   }
 
   for (j = 0; j < s->max_iterations; j++) {
     /* evaluate function at midpoint */
     m = (i->x0 + i->x1) / 2.0;
-    fm = function_eval(f, m);
+    fm = root_eval(f, m, r);
     /* check stop conditions */
     if (i->x0 == m || i->x1 == m ||
-        fabsl(i->x0 - i->x1) < s->epsilon) break;
+        fabsl(i->x0 - i->x1) < s->epsilon) {
+      r->reason = rootConverged;
+      break;
+    }
 
     /* update endpoints */
     if (fm < 0.0) {
@@ -109,7 +153,11 @@ int root_bisection(function_t *f, interval_t *i, stop_cond_t *s, long double *r)
               j, (i->x1 + i->x0) / 2.0, f0, f1);
   }
 
-  *r = (i->x0 + i->x1) / 2.0;
+  r->root = (i->x0 + i->x1) / 2.0;
+  /* the midpoint was evaluated unless the last step moved an endpoint */
+  r->residual = r->reason == rootConverged ? fm : root_eval(f, r->root, r);
+  r->width = fabsl(i->x1 - i->x0);
+  r->iterations = j;
   return 0;
 }
 
@@ -120,13 +168,14 @@ int root_bisection(function_t *f, interval_t *i, stop_cond_t *s, long double *r)
  * down-weighting is applied to improve method and
  * make it suprlinear convergent.
  * */
-int root_regulafalsi(function_t *f, interval_t *i, stop_cond_t *s, long double *r) {
-  long double m = 0.0, fm, f1, f0;
+int root_regulafalsi(function_t *f, interval_t *i, stop_cond_t *s, root_result_t *r) {
+  long double m = 0.0, fm = 0.0, f1, f0;
   size_t j;
   ssize_t side = 0;
 
-  f0 = function_eval(f, i->x0);
-  f1 = function_eval(f, i->x1);
+  root_result_init(r);
+  f0 = root_eval(f, i->x0, r);
+  f1 = root_eval(f, i->x1, r);
 
   /* f(x0) and f(x1) have opposite signs => contain a root */
   if (f0 > 0.0 && f1 < 0.0) {
@@ -134,6 +183,7 @@ int root_regulafalsi(function_t *f, interval_t *i, stop_cond_t *s, long double *
     pair_swap(&f0, &f1);
   } else if (!(f0 < 0.0 && f1 > 0.0)) {
     fprintf(stderr, "f(x0) * f(x1) !< 0\n");
+    r->reason = rootNoBracket;
     return 3;
   }
 
@@ -141,10 +191,14 @@ int root_regulafalsi(function_t *f, interval_t *i, stop_cond_t *s, long double *
     /* get the root of the secant */
     m = (f1 * i->x0 - f0 * i->x1) / (f1 - f0);
     /* check stop conditions */
-    if (fabsl(i->x0 - i->x1) < s->epsilon * fabsl(i->x0 + i->x1))
+    if (fabsl(i->x0 - i->x1) < s->epsilon * fabsl(i->x0 + i->x1)) {
+      r->reason = rootConverged;
+      /* m hasn't been evaluated yet */
+      fm = root_eval(f, m, r);
       break;
+    }
 
-    fm = function_eval(f, m);
+    fm = root_eval(f, m, r);
 
     /* update endpoints */
     if (fm < 0.0) {
@@ -158,17 +212,526 @@ int root_regulafalsi(function_t *f, interval_t *i, stop_cond_t *s, long double *
       if (side == 1) f0 /= 2.0;
       i->x1 = m; f1 = fm;
       side = 1;
-    } else
+    } else {
+      r->reason = rootConverged;
       break;
+    }
 
     if (root_search_verbose)
       fprintf(stderr, "i=%zu: x=%.15Lg f(x)=%.15Lg\n", j, m, fm);
   }
 
-  *r = m;
+  r->root = m;
+  r->residual = s->max_iterations ? fm : root_eval(f, m, r);
+  r->width = fabsl(i->x1 - i->x0);
+  r->iterations = j;
+  return 0;
+}
+
+/* Brent's method, keeps a bracket [a, b] around the root like bisection
+ * but steps with inverse quadratic interpolation (or the secant when only
+ * two distinct points are known). The step is taken only when it falls
+ * within the bracket and shrinks faster than bisection would, otherwise
+ * the bracket is bisected.
+ * b is the best estimate, c the previous one (f(b) and f(c) have opposite
+ * signs) and d the one before */
+typedef struct {
+  long double a, b, c, d, e, fa, fb, fc;
+} brent_t;
+
+/* start from [a, b], return 3 if f doesn't change sign over it */
+static int brent_init(brent_t *z, long double a, long double b,
+                      long double fa, long double fb) {
+  if ((fa > 0.0 && fb > 0.0) || (fa < 0.0 && fb < 0.0))
+    return 3;
+  z->a = a; z->fa = fa;
+  z->b = b; z->fb = fb;
+  z->c = a; z->fc = fa;
+  z->d = z->e = b - a;
+  return 0;
+}
+
+/* move b to the next point to evaluate, the caller sets fb.
+ * return 0 once b is within epsilon of the root */
+static int brent_step(brent_t *z, long double epsilon) {
+  long double p, q, m, tol;
+
+  /* keep b as the endpoint closest to the root */
+  if ((z->fb > 0.0 && z->fc > 0.0) || (z->fb < 0.0 && z->fc < 0.0)) {
+    z->c = z->a; z->fc = z->fa;
+    z->d = z->e = z->b - z->a;
+  }
+  if (fabsl(z->fc) < fabsl(z->fb)) {
+    z->a = z->b; z->b = z->c; z->c = z->a;
+    z->fa = z->fb; z->fb = z->fc; z->fc = z->fa;
+  }
+
+  tol = 2.0 * LDBL_EPSILON * fabsl(z->b) + epsilon / 2.0;
+  m = (z->c - z->b) / 2.0;
+  /* check stop conditions */
+  if (fabsl(m) <= tol || z->fb == 0.0)
+    return 0;
+
+  if (fabsl(z->e) >= tol && fabsl(z->fa) > fabsl(z->fb)) {
+    long double t = z->fb / z->fa;
+    if (z->a == z->c) {
+      /* secant */
+      p = 2.0 * m * t;
+      q = 1.0 - t;
+    } else {
+      /* inverse quadratic interpolation */
+      long double u = z->fa / z->fc, v = z->fb / z->fc;
+      p = t * (2.0 * m * u * (u - v) - (z->b - z->a) * (v - 1.0));
+      q = (u - 1.0) * (v - 1.0) * (t - 1.0);
+    }
+    if (p > 0.0)
+      q = -q;
+    else
+      p = -p;
+
+    /* accept the interpolation if it stays in the bracket and at least
+     * halves the step before last */
+    if (2.0 * p < fminl(3.0 * m * q - fabsl(tol * q), fabsl(z->e * q))) {
+      z->e = z->d;
+      z->d = p / q;
+    } else {
+      z->d = z->e = m;
+    }
+  } else {
+    z->d = z->e = m;
+  }
+
+  z->a = z->b; z->fa = z->fb;
+  z->b += fabsl(z->d) > tol ? z->d : (m > 0.0 ? tol : -tol);
+  return 1;
+}
+
+/* root, residual and width of a finished brent iteration */
+static void brent_result(const brent_t *z, root_result_t *r) {
+  r->root = z->b;
+  r->residual = z->fb;
+  r->width = fabsl(z->c - z->b);
+}
+
+int root_brent(function_t *f, interval_t *i, stop_cond_t *s, root_result_t *r) {
+  long double fa, fb;
+  brent_t z;
+  size_t j;
+
+  root_result_init(r);
+  fa = root_eval(f, i->x0, r);
+  fb = root_eval(f, i->x1, r);
+
+  if (brent_init(&z, i->x0, i->x1, fa, fb)) {
+    fprintf(stderr, "f(x0) * f(x1) !< 0\n");
+    r->reason = rootNoBracket;
+    return 3;
+  }
+
+  for (j = 0; j < s->max_iterations; j++) {
+    if (!brent_step(&z, s->epsilon)) {
+      r->reason = rootConverged;
+      break;
+    }
+    z.fb = root_eval(f, z.b, r);
+
+    if (root_search_verbose)
+      fprintf(stderr, "i=%zu: x=%.15Lg f(x)=%.15Lg d=%.15Lg\n", j, z.b, z.fb, z.d);
+  }
+
+  i->x0 = z.b;
+  i->x1 = z.c;
+  brent_result(&z, r);
+  r->iterations = j;
+  return 0;
+}
+
+/* run worker over job in nthreads threads (0: one per cpu), no more than
+ * the number of items. The calling thread is one of them */
+static void run_workers(void *(*worker)(void*), void *job, size_t nthreads, size_t items) {
+  size_t k, started = 0;
+
+  if (nthreads == 0) {
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    nthreads = ncpu > 0 ? ncpu : 1;
+  }
+  if (nthreads > items)
+    nthreads = items ? items : 1;
+
+  pthread_t *threads = (pthread_t*)zmalloc(sizeof(pthread_t) * nthreads);
+  for (k = 1; k < nthreads; k++)
+    if (pthread_create(&threads[started], NULL, worker, job) == 0)
+      started++;
+  worker(job);
+  for (k = 0; k < started; k++)
+    pthread_join(threads[k], NULL);
+  free(threads);
+}
+
+/* brackets found by the scan, a == b for samples that hit a root */
+typedef struct {
+  long double a, b;
+} bracket_t;
+
+typedef struct {
+  bracket_t *b;
+  size_t n, cap;
+} brackets_t;
+
+static void brackets_push(brackets_t *v, long double a, long double b) {
+  if (v->n == v->cap) {
+    v->cap = v->cap ? 2 * v->cap : 16;
+    v->b = (bracket_t*)xrealloc(v->b, sizeof(bracket_t) * v->cap);
+  }
+  v->b[v->n].a = a;
+  v->b[v->n++].b = b;
+}
+
+/* look for sign changes in [a, b], halving it while its enclosure may
+ * hold a root */
+static void scan_cell(function_t *f, long double a, long double b,
+                      long double fa, long double fb, int depth, brackets_t *v) {
+  if ((fa < 0.0 && fb > 0.0) || (fa > 0.0 && fb < 0.0)) {
+    brackets_push(v, a, b);
+    return;
+  }
+
+  /* f vanishes all over the cell, its ends were reported already */
+  if (fa == 0.0 && fb == 0.0)
+    return;
+
+  ival_t x = { fminl(a, b), fmaxl(a, b) }, y;
+  if (depth == 0 || function_eval_interval(f, x, &y) || y.lo > 0.0 || y.hi < 0.0)
+    return;
+
+  long double m = (a + b) / 2.0, fm = function_eval(f, m);
+  scan_cell(f, a, m, fa, fm, depth - 1, v);
+  /* a zero next to another zero sample belongs to the same run */
+  if (fm == 0.0 && fa != 0.0 && fb != 0.0)
+    brackets_push(v, m, m);
+  scan_cell(f, m, b, fm, fb, depth - 1, v);
+}
+
+typedef struct {
+  const function_t *f;
+  const stop_cond_t *s;
+  brackets_t *v;
+  long double *roots;
+  int *ret;
+  atomic_size_t next;
+} scan_job_t;
+
+static void * scan_worker(void *arg) {
+  scan_job_t *job = (scan_job_t*)arg;
+  function_t *f = function_clone(job->f);
+  stop_cond_t s = *job->s;
+  size_t k;
+
+  while ((k = atomic_fetch_add(&job->next, 1)) < job->v->n) {
+    interval_t i = { job->v->b[k].a, job->v->b[k].b };
+    root_result_t r;
+    if (i.x0 == i.x1)
+      job->roots[k] = i.x0;
+    else if ((job->ret[k] = root_brent(f, &i, &s, &r)) == 0)
+      job->roots[k] = r.root;
+  }
+  function_destroy(f);
+  return NULL;
+}
+
+ssize_t root_scan(function_t *f, interval_t *i, stop_cond_t *s, size_t nthreads,
+                  long double **roots) {
+  brackets_t v = { NULL, 0, 0 };
+  long double w, fa, fb;
+  size_t k, n;
+
+  if (roots)
+    *roots = NULL;
+  if (!f || !i || !s || !roots)
+    return -1;
+  w = (i->x1 - i->x0) / ROOT_SCAN_CELLS;
+  if (i->x0 == i->x1) {
+    *roots = (long double*)zmalloc(sizeof(long double));
+    **roots = i->x0;
+    return function_eval(f, i->x0) == 0.0;
+  }
+
+  /* the grid runs from the lower end so the roots come out sorted */
+  interval_t g = *i;
+  if (w < 0.0) {
+    interval_swap(&g);
+    w = -w;
+  }
+
+  fa = function_eval(f, g.x0);
+  if (fa == 0.0)
+    brackets_push(&v, g.x0, g.x0);
+  for (k = 0; k < ROOT_SCAN_CELLS; k++) {
+    long double a = g.x0 + k * w, b = k + 1 == ROOT_SCAN_CELLS ? g.x1 : g.x0 + (k + 1) * w;
+    fb = function_eval(f, b);
+    scan_cell(f, a, b, fa, fb, ROOT_SCAN_DEPTH, &v);
+    if (fb == 0.0 && fa != 0.0)
+      brackets_push(&v, b, b);
+    fa = fb;
+  }
+
+  /* the same bracket can't be refined twice */
+  for (k = n = 0; k < v.n; k++)
+    if (n == 0 || v.b[k].a != v.b[n-1].a || v.b[k].b != v.b[n-1].b)
+      v.b[n++] = v.b[k];
+  v.n = n;
+
+  scan_job_t job;
+  job.f = f;
+  job.s = s;
+  job.v = &v;
+  job.roots = (long double*)zmalloc(sizeof(long double) * (v.n + 1));
+  job.ret = (int*)zmalloc(sizeof(int) * (v.n + 1));
+  atomic_init(&job.next, 0);
+
+  run_workers(scan_worker, &job, nthreads, v.n);
+
+  for (k = n = 0; k < v.n; k++)
+    if (job.ret[k] == 0)
+      job.roots[n++] = job.roots[k];
+  free(job.ret);
+  free(v.b);
+  *roots = job.roots;
+  return n;
+}
+
+typedef struct {
+  const function_t *f;
+  const char *const *params;
+  size_t nparams;
+  const long double *values;
+  const interval_t *brackets;
+  size_t n;
+  const stop_cond_t *s;
+  root_result_t *results;
+  atomic_size_t next;   /* first item of the next block */
+} batch_job_t;
+
+/* f at x with the parameters of item k */
+static long double batch_eval(function_t *f, long double **p, const batch_job_t *job,
+                              size_t k, long double x) {
+  size_t j;
+  for (j = 0; j < job->nparams; j++)
+    *p[j] = job->values[k * job->nparams + j];
+  return function_eval(f, x);
+}
+
+static void * batch_worker(void *arg) {
+  batch_job_t *job = (batch_job_t*)arg;
+  function_t *f = function_clone(job->f);
+  long double **p = (long double**)xmalloc(sizeof(long double*) * (job->nparams + 1));
+  brent_t z[ROOT_BATCH_LANES];
+  size_t live[ROOT_BATCH_LANES];
+  size_t j, k, l, lo, hi, nlive, it;
+
+  for (j = 0; j < job->nparams; j++)
+    p[j] = function_param(f, job->params[j]);
+
+  while ((lo = atomic_fetch_add(&job->next, ROOT_BATCH_LANES)) < job->n) {
+    hi = lo + ROOT_BATCH_LANES < job->n ? lo + ROOT_BATCH_LANES : job->n;
+    root_result_t *res = job->results + lo;
+
+    for (k = lo, nlive = 0; k < hi; k++) {
+      const interval_t *b = &job->brackets[k];
+      root_result_init(&res[k - lo]);
+      long double fa = batch_eval(f, p, job, k, b->x0),
+                  fb = batch_eval(f, p, job, k, b->x1);
+      res[k - lo].evals = 2;
+      if (brent_init(&z[k - lo], b->x0, b->x1, fa, fb))
+        res[k - lo].reason = rootNoBracket;
+      else
+        live[nlive++] = k - lo;
+    }
+
+    /* all the lanes left take a step, then they are all evaluated */
+    for (it = 0; nlive && it < job->s->max_iterations; it++) {
+      for (l = j = 0; l < nlive; l++) {
+        if (brent_step(&z[live[l]], job->s->epsilon))
+          live[j++] = live[l];
+        else
+          res[live[l]].reason = rootConverged;
+      }
+      nlive = j;
+      for (l = 0; l < nlive; l++) {
+        z[live[l]].fb = batch_eval(f, p, job, lo + live[l], z[live[l]].b);
+        res[live[l]].iterations++;
+        res[live[l]].evals++;
+      }
+    }
+
+    for (k = lo; k < hi; k++)
+      if (res[k - lo].reason != rootNoBracket)
+        brent_result(&z[k - lo], &res[k - lo]);
+  }
+
+  free(p);
+  function_destroy(f);
+  return NULL;
+}
+
+int root_brent_batch(const char *func, const char *const *params, size_t nparams,
+                     const long double *values, const interval_t *brackets, size_t n,
+                     stop_cond_t *s, size_t nthreads, root_result_t *results) {
+  function_t *f;
+
+  if (!func || !s || (nparams && (!params || !values)) || (n && (!brackets || !results)))
+    return -1;
+  if (!(f = function_create(func)))
+    return -1;
+
+  batch_job_t job;
+  job.f = f;
+  job.params = params;
+  job.nparams = nparams;
+  job.values = values;
+  job.brackets = brackets;
+  job.n = n;
+  job.s = s;
+  job.results = results;
+  atomic_init(&job.next, 0);
+
+  run_workers(batch_worker, &job, nthreads, (n + ROOT_BATCH_LANES - 1) / ROOT_BATCH_LANES);
+  function_destroy(f);
   return 0;
 }
 
+/* p(z) and p'(z) by horner's rule, bound gets the rounding error bound
+ * of p(z) (in units of the epsilon) */
+static void poly_eval_complex(const long double *coef, size_t n, long double complex z,
+                      long double complex *p, long double complex *dp, long double *bound) {
+  long double az = cabsl(z);
+  size_t k;
+
+  *p = coef[n];
+  *dp = 0.0;
+  *bound = fabsl(coef[n]);
+  for (k = n; k-- > 0;) {
+    *dp = *dp * z + *p;
+    *p = *p * z + coef[k];
+    *bound = *bound * az + fabsl(coef[k]);
+  }
+}
+
+static int root_cmp(const void *a, const void *b) {
+  long double complex x = *(const long double complex*)a, y = *(const long double complex*)b;
+  if (creall(x) != creall(y))
+    return creall(x) < creall(y) ? -1 : 1;
+  return cimagl(x) < cimagl(y) ? -1 : cimagl(x) > cimagl(y);
+}
+
+/* Aberth's method, every root z_i takes a newton step corrected by the
+ * pull of the others:
+ *                    p(z_i)/p'(z_i)
+ * w_i = ----------------------------------------
+ *        1 - p(z_i)/p'(z_i) * sum 1/(z_i - z_j)
+ *                             j!=i
+ * Steps are applied as soon as they are known (gauss-seidel style), a
+ * root stops once its step is below epsilon (relative to |z_i|) or p(z_i)
+ * is within the rounding error of its evaluation */
+ssize_t root_polynomial(const long double *coef, size_t n, stop_cond_t *s,
+                        long double complex **roots) {
+  size_t i, j, k, z, left;
+  long double complex *r;
+  char *done;
+
+  if (!coef || !s || !roots)
+    return -1;
+  *roots = NULL;
+  /* the leading coefficient must not vanish */
+  while (n > 0 && coef[n] == 0.0)
+    n--;
+  if (n == 0 && coef[0] == 0.0) {
+    fprintf(stderr, "the zero polynomial has no isolated roots\n");
+    return -1;
+  }
+  r = (long double complex*)zmalloc(sizeof(long double complex) * (n + 1));
+  /* roots at 0 are exact, they are deflated away */
+  for (z = 0; z < n && coef[z] == 0.0; z++)
+    r[z] = 0.0;
+  coef += z;
+  n -= z;
+
+  /* start on a circle holding every root (fujiwara's bound), turned off
+   * the axes so that conjugate pairs aren't symmetric from the start */
+  long double radius = 0.0;
+  for (k = 0; k < n; k++) {
+    long double b = powl(fabsl(coef[k] / coef[n]), 1.0 / (n - k));
+    radius = fmaxl(radius, k == 0 ? b / powl(2.0, 1.0 / n) : b);
+  }
+  radius *= 2.0;
+  for (i = 0; i < n; i++) {
+    long double t = 2.0 * acosl(-1.0) * i / n + 0.4;
+    r[z + i] = radius * (cosl(t) + sinl(t) * I);
+  }
+
+  done = (char*)zmalloc(n + 1);
+  long double complex *x = r + z;
+  for (j = 0, left = n; left > 0 && j < s->max_iterations; j++) {
+    for (i = 0; i < n; i++) {
+      long double complex p, dp, sum = 0.0, w;
+      long double bound;
+
+      if (done[i])
+        continue;
+      poly_eval_complex(coef, n, x[i], &p, &dp, &bound);
+      if (cabsl(p) <= 4.0 * LDBL_EPSILON * bound) {
+        done[i] = 1;
+        left--;
+        continue;
+      }
+      for (k = 0; k < n; k++)
+        if (k != i)
+          sum += 1.0 / (x[i] - x[k]);
+      w = p / dp;
+      w /= 1.0 - w * sum;
+      x[i] -= w;
+
+      if (cabsl(w) <= s->epsilon * cabsl(x[i])) {
+        done[i] = 1;
+        left--;
+      }
+
+      if (root_search_verbose)
+        fprintf(stderr, "i=%zu: z%zu=%.15Lg%+.15Lgi |w|=%.15Lg\n",
+                j, i, creall(x[i]), cimagl(x[i]), cabsl(w));
+    }
+  }
+  free(done);
+
+  if (left > 0) {
+    fprintf(stderr, "%zu of %zu roots didn't converge\n", left, n);
+    free(r);
+    return -1;
+  }
+
+  qsort(r, n + z, sizeof(long double complex), root_cmp);
+  *roots = r;
+  return n + z;
+}
+
+ssize_t root_polynomial_function(function_t *f, stop_cond_t *s,
+                                 long double complex **roots) {
+  long double *coef;
+  ssize_t n;
+
+  if (roots)
+    *roots = NULL;
+  if (!f || !roots)
+    return -1;
+  if ((n = function_polynomial(f, &coef)) < 0) {
+    fprintf(stderr, "not a polynomial in x\n");
+    return -1;
+  }
+  n = root_polynomial(coef, n, s, roots);
+  free(coef);
+  return n;
+}
+
 /* System of linear equations */
 
 /* Solve a system of linear equations using Gauss-Seidel method
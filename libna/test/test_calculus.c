@@ -20,7 +20,7 @@ void test_derivates(void) {
   ASSERT_EQ(derivate_1(f, 5.0), -75.0-sinl(5.0));
   ASSERT_EQ(derivate_1(f, 0.0), 0.0);
   ASSERT_EQ(derivate_2(f, 0.0), -1.0);
-  ASSERT_EQ(derivate_2(f, 3.75), -21.6794);
+  ASSERT_EQ(derivate_2(f, 3.75), -21.67944);
   ASSERT_EQ(derivate(f, 3, -34.2), -6.34995);
   ASSERT_EQ(derivate(f, 3, -3.2), -5.94163);
   function_destroy(f);
@@ -34,12 +34,20 @@ void test_derivates(void) {
 }
 
 void test_arclength(void) {
+  size_t hits, misses;
   function_t *f = function_create("2**x - log(x)");
+  /* a stencil per simpson node took 4796 evaluations */
+  function_memoize(f, 4096);
   ASSERT_EQ(arc_length(f, 0.5, 2.3), 3.0663188081);
+  function_memo_stats(f, &hits, &misses);
+  assert(hits + misses <= 1199);
   function_destroy(f);
 
   f = function_create("1/x + sin(x)**0.3");
+  function_memoize(f, 4096);
   ASSERT_EQ(arc_length(f, 0.5, 2.3), 2.4417982309);
+  function_memo_stats(f, &hits, &misses);
+  assert(hits + misses <= 1199);
   function_destroy(f);
 
   f = function_create("3.5*x**4 - 30.3*x**3 + 7.2*x**2 - 3.4*x + 32.0");
@@ -49,6 +57,14 @@ void test_arclength(void) {
   f = function_create("3.5*x**4 - 7.2*x**2 - 3.4*x - 32.0");
   ASSERT_EQ(arc_length(f, -1.5, 0.73), 14.196939434);
   function_destroy(f);
+
+  /* f isn't sampled past the ends, it may not be defined there */
+  f = function_create("log(x)");
+  ASSERT_EQ(arc_length(f, 0.01, 1.0), 4.8311323422);
+  function_destroy(f);
+  f = function_create("(1 - x**2)**0.5");
+  ASSERT_EQ(arc_length(f, -0.99, 0.99), 2 * asinl(0.99));
+  function_destroy(f);
 }
 
 void test_integration(void) {
@@ -61,11 +77,116 @@ void test_integration(void) {
   function_destroy(f);
 }
 
+void test_romberg(void) {
+  size_t hits, misses;
+
+  /* the cache tells the evaluations apart, none of them is repeated */
+  function_t *f = function_create("2**x - log(x)");
+  function_memoize(f, 4096);
+  ASSERT_EQ(integrate_romberg(f, 0.5, 2.3), 4.60212);
+  function_memo_stats(f, &hits, &misses);
+  assert(hits == 0 && misses <= 257);
+  function_destroy(f);
+
+  f = function_create("1/x - sin(x)**3");
+  function_memoize(f, 4096);
+  ASSERT_EQ(integrate_romberg(f, 2.45, 8.145), 1.54018);
+  function_memo_stats(f, &hits, &misses);
+  assert(hits == 0 && misses <= 513);
+  function_destroy(f);
+
+  /* integrals that cancel out converge too */
+  f = function_create("sin(x)");
+  ASSERT_EQ(integrate_romberg(f, -1.0, 1.0), 0.0);
+  ASSERT_EQ(integrate_romberg(f, 0.0, 2*acosl(-1.0)), 0.0);
+  ASSERT_EQ(integrate_romberg(f, acosl(-1.0), 0.0), -2.0);
+  function_destroy(f);
+}
+
+void test_gauss_kronrod(void) {
+  long double r, err;
+  size_t evals;
+
+  function_t *f = function_create("2**x - log(x)");
+  assert(integrate_gk(f, 0.5, 2.3, 1.0e-12, 0.0, &r, &err, &evals) == 0);
+  ASSERT_EQ(r, 4.60212);
+  assert(err <= 1.0e-12 && evals <= 75);
+  function_destroy(f);
+
+  /* long ranges cost no more than their features */
+  f = function_create("x**2");
+  assert(integrate_gk(f, 0.0, 1.0e6, 0.0, 1.0e-15, &r, &err, &evals) == 0);
+  assert(fabsl(r / (1.0e18 / 3.0) - 1.0) < 1.0e-15 && evals == 15);
+  function_destroy(f);
+
+  f = function_create("sin(x)");
+  assert(integrate_gk(f, 0.0, 1000.0, 1.0e-10, 0.0, &r, &err, &evals) == 0);
+  assert(fabsl(r - (1.0 - cosl(1000.0))) < 1.0e-10 && evals < 10000);
+  /* and short ones get the same relative accuracy */
+  assert(integrate_gk(f, 1.0, 1.0 + 1.0e-7, 0.0, 1.0e-12, &r, NULL, NULL) == 0);
+  assert(fabsl(r / (cosl(1.0) - cosl(1.0 + 1.0e-7)) - 1.0) < 1.0e-12);
+  function_destroy(f);
+
+  /* panels concentrate around the peak, the estimate bounds the error */
+  f = function_create("1/(0.0001 + x**2)");
+  assert(integrate_gk(f, -1.0, 1.0, 1.0e-9, 0.0, &r, &err, &evals) == 0);
+  assert(fabsl(r - 200.0 * atanl(100.0)) <= err && evals < 1000);
+  /* reversed bounds flip the sign */
+  assert(integrate_gk(f, 1.0, -1.0, 1.0e-9, 0.0, &r, NULL, NULL) == 0);
+  ASSERT_EQ(r, -200.0 * atanl(100.0));
+  /* unreachable tolerance */
+  assert(integrate_gk(f, -1.0, 1.0, 0.0, 0.0, &r, &err, &evals) == 1);
+  assert(evals == 15 * (INTEGRATE_MAX_PANELS - 1));
+  function_destroy(f);
+}
+
+void test_parallel(void) {
+  long double r, r1, err, err1;
+  size_t evals, evals1, nthreads;
+
+  function_t *f = function_create("sin(x)*exp(-x/300)");
+  assert(integrate_parallel(f, 0.0, 2000.0, 1.0e-9, 0.0, 1, &r1, &err1, &evals1) == 0);
+  ASSERT_EQ(r1, (1.0 - expl(-2000.0/300.0) *
+                 (sinl(2000.0)/300.0 + cosl(2000.0))) / (1.0 + 1.0/90000.0));
+  assert(err1 <= 1.0e-9);
+  /* the same bits whatever the number of threads */
+  for (nthreads = 2; nthreads <= 8; nthreads *= 2) {
+    assert(integrate_parallel(f, 0.0, 2000.0, 1.0e-9, 0.0, nthreads, &r, &err, &evals) == 0);
+    assert(r == r1 && err == err1 && evals == evals1);
+  }
+  /* the caller's function is left alone */
+  ASSERT_EQ(function_eval(f, 0.0), 0.0);
+  function_destroy(f);
+
+  /* clones evaluate like the original */
+  f = function_create("x**2 + 1");
+  function_t *c = function_clone(f);
+  assert(function_eval(c, 3.0) == function_eval(f, 3.0));
+  function_destroy(f);
+  assert(function_eval(c, 2.0) == 5.0);
+  function_destroy(c);
+
+  /* clones take the values of the variables set on the original */
+  f = function_create("x - a");
+  *function_param(f, "a") = 0.5;
+  c = function_clone(f);
+  assert(function_eval(c, 2.0) == 1.5);
+  function_destroy(c);
+  for (nthreads = 1; nthreads <= 4; nthreads *= 2) {
+    assert(integrate_parallel(f, 0.0, 1.0, 1.0e-12, 0.0, nthreads, &r, &err, &evals) == 0);
+    ASSERT_EQ(r, 0.0);
+  }
+  function_destroy(f);
+}
+
 
 int main(void) {
   test_derivates();
   test_arclength();
   test_integration();
+  test_romberg();
+  test_gauss_kronrod();
+  test_parallel();
   return 0;
 }
 
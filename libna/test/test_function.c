@@ -0,0 +1,74 @@
+#include <math.h>
+#include <stdio.h>
+#include <assert.h>
+
+#include "na/function.h"
+#include "na/calculus.h"
+
+#define EPSILON 1.0e-10
+#define ASSERT_EQ(x, y) assert(fabsl((x)-(y)) < EPSILON)
+
+void test_eval(void) {
+  function_t *f = function_create("cos(x) - x**3");
+  ASSERT_EQ(function_eval(f, 0.0), 1.0);
+  ASSERT_EQ(function_eval(f, 2.0), cosl(2.0) - 8.0);
+  function_destroy(f);
+}
+
+void test_memoize(void) {
+  size_t hits, misses;
+  function_t *f = function_create("gamma(x) + x**2");
+
+  /* disabled by default */
+  function_eval(f, 3.0);
+  function_memo_stats(f, &hits, &misses);
+  assert(hits == 0 && misses == 0);
+
+  function_memoize(f, 60);
+  ASSERT_EQ(function_eval(f, 3.0), 11.0);
+  ASSERT_EQ(function_eval(f, 3.0), 11.0);
+  ASSERT_EQ(function_eval(f, 4.0), 22.0);
+  function_memo_stats(f, &hits, &misses);
+  assert(hits == 1 && misses == 2);
+
+  /* the same stencil points get reused */
+  long double d0 = derivate_1(f, 2.5), d1 = derivate_1(f, 2.5);
+  assert(d0 == d1);
+  function_memo_stats(f, &hits, &misses);
+  assert(hits == 5 && misses == 6);
+
+  /* 0.0 and -0.0 are different keys */
+  function_destroy(f);
+  f = function_create("1/x");
+  function_memoize(f, 16);
+  assert(function_eval(f, 0.0) > 0.0);
+  assert(function_eval(f, -0.0) < 0.0);
+  function_memo_stats(f, &hits, &misses);
+  assert(hits == 0 && misses == 2);
+
+  /* resizing resets the cache */
+  function_memoize(f, 0);
+  function_eval(f, 1.0);
+  function_memo_stats(f, &hits, &misses);
+  assert(hits == 0 && misses == 0);
+  function_destroy(f);
+}
+
+void test_interval(void) {
+  function_t *f = function_create("cos(x) - x**3");
+  ival_t r, x = { 1.0, 2.0 };
+  assert(function_eval_interval(f, x, &r) == 0);
+  /* decreasing on [1, 2] */
+  assert(r.lo <= cosl(2.0) - 8.0 && r.hi >= cosl(1.0) - 1.0);
+  assert(r.hi < 0.0);
+  function_destroy(f);
+}
+
+int main(void) {
+  test_eval();
+  test_memoize();
+  test_interval();
+  return 0;
+}
+
+/* vim: set sw=2 sts=2 : */
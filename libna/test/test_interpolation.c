@@ -0,0 +1,75 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "baas/common.h"
+#include "na/interpolation.h"
+
+#define TOLERANCE 1.0e-12
+#define ASSERT_EQ(x, y) assert(fabsl((x)-(y)) < TOLERANCE)
+
+static long double cubic(long double x) {
+  return x * x * x - 2.0 * x + 1.0;
+}
+
+void test_newton(void) {
+  vector2_t pts[] = { { 0.5, 0 }, { 1.3, 0 }, { 2.0, 0 }, { 3.7, 0 }, { -1.0, 0 } };
+  size_t k, n = sizeof(pts) / sizeof(pts[0]);
+  const long double *c;
+  long double r;
+
+  for (k = 0; k < n; k++)
+    pts[k].x1 = cubic(pts[k].x0);
+
+  newton_poly_t *p = newton_poly_create(pts, n);
+  /* the points are left alone */
+  for (k = 0; k < n; k++)
+    assert(pts[k].x1 == cubic(pts[k].x0));
+
+  /* a cubic through 5 points: f[x0..x3] is the leading coefficient */
+  assert(newton_poly_coef(p, &c) == n);
+  ASSERT_EQ(c[0], cubic(0.5));
+  ASSERT_EQ(c[3], 1.0);
+  ASSERT_EQ(c[4], 0.0);
+
+  for (k = 0; k < n; k++)
+    ASSERT_EQ(newton_poly_eval(p, pts[k].x0), pts[k].x1);
+  ASSERT_EQ(newton_poly_eval(p, 2.5), cubic(2.5));
+  ASSERT_EQ(newton_poly_eval(p, -3.0), cubic(-3.0));
+
+  /* batches give the same values, across blocks too */
+  size_t m = 3 * NEWTON_POLY_BLOCK + 5;
+  long double *x = zmalloc(sizeof(long double) * m),
+              *y = zmalloc(sizeof(long double) * m);
+  for (k = 0; k < m; k++)
+    x[k] = -2.0 + k / 50.0;
+  newton_poly_eval_n(p, x, m, y);
+  for (k = 0; k < m; k++)
+    assert(y[k] == newton_poly_eval(p, x[k]));
+  free(x);
+  free(y);
+  newton_poly_destroy(p);
+
+  /* same values one point at a time */
+  assert(interpolate_newton(pts, n, 2.5, &r) == 0);
+  ASSERT_EQ(r, cubic(2.5));
+  assert(interpolate_lagrange(pts, n, 2.5, &r) == 0);
+  ASSERT_EQ(r, cubic(2.5));
+
+  /* a single point is a constant */
+  p = newton_poly_create(pts, 1);
+  ASSERT_EQ(newton_poly_eval(p, 10.0), cubic(0.5));
+  newton_poly_destroy(p);
+
+  pts[2].x0 = pts[0].x0;
+  assert(newton_poly_create(pts, n) == NULL);
+  assert(interpolate_newton(pts, n, 2.5, &r) == 1);
+}
+
+int main(void) {
+  test_newton();
+  return 0;
+}
+
+/* vim: set sw=2 sts=2 : */
@@ -0,0 +1,336 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "baas/common.h"
+#include "na/function.h"
+#include "na/root_finding.h"
+
+#define TOLERANCE 1.0e-12
+#define ASSERT_EQ(x, y) assert(fabsl((x)-(y)) < TOLERANCE)
+
+/* evaluations the method took to find the root of func in [x0, x1] */
+static size_t brent(const char *func, long double x0, long double x1, long double *r) {
+  size_t hits, misses;
+  function_t *f = function_create(func);
+  interval_t *i = interval_create(x0, x1);
+  stop_cond_t *s = stop_cond_create(1.0e-14, 200);
+
+  function_memoize(f, 1024);
+  root_result_t res;
+  assert(root_brent(f, i, s, &res) == 0);
+  assert(res.reason == rootConverged);
+  *r = res.root;
+  /* the bracket is left around the root */
+  assert(fminl(i->x0, i->x1) <= *r && *r <= fmaxl(i->x0, i->x1));
+  function_memo_stats(f, &hits, &misses);
+  assert(res.evals == hits + misses && res.iterations == res.evals - 2);
+  assert(fabsl(res.residual) <= fabsl(function_eval(f, i->x1)));
+
+  function_destroy(f);
+  interval_destroy(i);
+  stop_cond_destroy(s);
+  return hits + misses;
+}
+
+void test_brent(void) {
+  long double r;
+
+  assert(brent("cos(x) - x**3", 0.0, 1.0, &r) <= 12);
+  ASSERT_EQ(r, 0.865474033101614);
+  /* either orientation of the bracket */
+  assert(brent("cos(x) - x**3", 1.0, 0.0, &r) <= 12);
+  ASSERT_EQ(r, 0.865474033101614);
+
+  assert(brent("x**2 - 2", 0.0, 2.0, &r) <= 12);
+  ASSERT_EQ(r, sqrtl(2.0));
+
+  /* a root at an endpoint */
+  brent("x - 1", 1.0, 3.0, &r);
+  assert(r == 1.0);
+
+  /* flat around the root, interpolation crawls and gives way to bisection
+   * (which alone takes ~50 evaluations) */
+  assert(brent("x**9", -1.0, 4.0, &r) <= 150);
+  assert(fabsl(r) < 1.0e-14);
+
+  /* steep and far from linear */
+  assert(brent("exp(x) - 1e6", 0.0, 50.0, &r) <= 30);
+  ASSERT_EQ(r, logl(1.0e6));
+
+  /* no sign change, no bracket */
+  function_t *f = function_create("x**2 + 1");
+  interval_t *i = interval_create(-1.0, 1.0);
+  stop_cond_t *s = stop_cond_create(1.0e-14, 200);
+  root_result_t res;
+  assert(root_brent(f, i, s, &res) == 3);
+  assert(res.reason == rootNoBracket);
+  function_destroy(f);
+  interval_destroy(i);
+  stop_cond_destroy(s);
+}
+
+typedef int (*bracketed_t)(function_t*, interval_t*, stop_cond_t*, root_result_t*);
+
+/* run method on cos(x) - x**3 in [0, 1], the result accounts for every evaluation */
+static void stats(bracketed_t method, size_t max_iterations, root_result_t *r) {
+  size_t hits, misses;
+  function_t *f = function_create("cos(x) - x**3");
+  interval_t *i = interval_create(0.0, 1.0);
+  stop_cond_t *s = stop_cond_create(1.0e-12, max_iterations);
+
+  function_memoize(f, 1024);
+  if (method)
+    assert(method(f, i, s, r) == 0);
+  else
+    assert(root_newton(f, 1.0, s, r) == 0);
+  function_memo_stats(f, &hits, &misses);
+  assert(r->evals == hits + misses);
+  assert(r->iterations <= max_iterations);
+  ASSERT_EQ(r->residual, function_eval(f, r->root));
+
+  function_destroy(f);
+  interval_destroy(i);
+  stop_cond_destroy(s);
+}
+
+void test_stats(void) {
+  bracketed_t methods[] = { root_secant, root_bisection, root_regulafalsi, root_brent, NULL };
+  root_result_t r;
+  size_t k;
+
+  for (k = 0; k < sizeof(methods) / sizeof(methods[0]); k++) {
+    stats(methods[k], 200, &r);
+    assert(r.reason == rootConverged);
+    assert(fabsl(r.root - 0.865474033101614) < 1.0e-11);
+    assert(fabsl(r.residual) < 1.0e-11 && r.width < 1.0e-6);
+
+    stats(methods[k], 3, &r);
+    assert(r.reason == rootMaxIterations && r.iterations == 3);
+  }
+
+  /* bisection halves the bracket every iteration */
+  stats(root_bisection, 200, &r);
+  assert(r.width < 1.0e-12 && r.iterations >= 40);
+}
+
+/* roots of func in [x0, x1], evals gets the evaluations of the scan */
+static ssize_t scan(const char *func, long double x0, long double x1, size_t nthreads,
+                    long double **roots, size_t *evals) {
+  size_t hits, misses;
+  function_t *f = function_create(func);
+  interval_t *i = interval_create(x0, x1);
+  stop_cond_t *s = stop_cond_create(1.0e-14, 200);
+
+  function_memoize(f, 1 << 16);
+  ssize_t n = root_scan(f, i, s, nthreads, roots);
+  function_memo_stats(f, &hits, &misses);
+  *evals = hits + misses;
+
+  function_destroy(f);
+  interval_destroy(i);
+  stop_cond_destroy(s);
+  return n;
+}
+
+void test_scan(void) {
+  long double *r, *r4;
+  size_t evals;
+  ssize_t k, n;
+
+  /* sorted, whatever the orientation of the interval */
+  n = scan("sin(x)", 10.0, -10.0, 1, &r, &evals);
+  assert(n == 7);
+  for (k = 0; k < n; k++)
+    ASSERT_EQ(r[k], (k - 3) * 3.14159265358979323846L);
+
+  /* same roots with more workers */
+  assert(scan("sin(x)", -10.0, 10.0, 4, &r4, &evals) == n);
+  for (k = 0; k < n; k++)
+    assert(r[k] == r4[k]);
+  free(r);
+  free(r4);
+
+  /* a root on the grid is reported once */
+  n = scan("sin(x)", 0.0, 7.0, 0, &r, &evals);
+  assert(n == 3);
+  assert(r[0] == 0.0);
+  free(r);
+
+  /* runs of zeros are a single root */
+  n = scan("sin(x)", 0.0, 0.0, 0, &r, &evals);
+  assert(n == 1 && r[0] == 0.0);
+  free(r);
+  n = scan("max(x, 0)", -1.0, 0.0, 0, &r, &evals);
+  assert(n == 1 && r[0] == -1.0);
+  free(r);
+  n = scan("max(x, 0) - 0.5", -1.0, 1.0, 0, &r, &evals);
+  assert(n == 1);
+  ASSERT_EQ(r[0], 0.5);
+  free(r);
+  n = scan("x * max(x, 0)", -1.0, 1.0, 0, &r, &evals);
+  assert(n == 1 && r[0] == -1.0);
+  free(r);
+
+  /* a pair closer than a grid cell */
+  n = scan("x**2 - 1e-6", -1.0, 1.3, 0, &r, &evals);
+  assert(n == 2);
+  ASSERT_EQ(r[0], -1.0e-3);
+  ASSERT_EQ(r[1], 1.0e-3);
+  free(r);
+
+  /* parameters reach the workers and the enclosures */
+  function_t *f = function_create("x**2 - a");
+  interval_t *i = interval_create(-1.0, 1.3);
+  stop_cond_t *s = stop_cond_create(1.0e-14, 200);
+  *function_param(f, "a") = 1.0e-6;
+  assert(root_scan(f, i, s, 4, &r) == 2);
+  ASSERT_EQ(r[0], -1.0e-3);
+  ASSERT_EQ(r[1], 1.0e-3);
+  free(r);
+  function_destroy(f);
+  interval_destroy(i);
+  stop_cond_destroy(s);
+
+  /* the enclosure rules out every cell, nothing but the grid is sampled */
+  n = scan("exp(x) + 2", -5.0, 5.0, 0, &r, &evals);
+  assert(n == 0);
+  assert(evals == ROOT_SCAN_CELLS + 1);
+  free(r);
+}
+
+void test_batch(void) {
+  const char *params[] = { "a", "b" };
+  size_t k, n = 1000;
+  long double *values = zmalloc(sizeof(long double) * 2 * n);
+  interval_t *brackets = zmalloc(sizeof(interval_t) * n);
+  root_result_t *res = zmalloc(sizeof(root_result_t) * n),
+                *res4 = zmalloc(sizeof(root_result_t) * n);
+  stop_cond_t *s = stop_cond_create(1.0e-14, 200);
+
+  for (k = 0; k < n; k++) {
+    values[2 * k] = 0.01 + k / 10.0;
+    values[2 * k + 1] = (k % 3) / 10.0;
+    brackets[k].x0 = 0.0;
+    brackets[k].x1 = 2.0;
+  }
+  /* no sign change */
+  brackets[7].x1 = 0.1;
+
+  assert(root_brent_batch("cos(x) - a*x**3 + b*x", params, 2, values, brackets, n, s, 1, res) == 0);
+  assert(root_brent_batch("cos(x) - a*x**3 + b*x", params, 2, values, brackets, n, s, 4, res4) == 0);
+
+  /* same as solving one item at a time */
+  function_t *f = function_create("cos(x) - a*x**3 + b*x");
+  for (k = 0; k < n; k++) {
+    interval_t i = brackets[k];
+    root_result_t r;
+    *function_param(f, "a") = values[2 * k];
+    *function_param(f, "b") = values[2 * k + 1];
+    if (k == 7) {
+      assert(res[k].reason == rootNoBracket && isnan(res[k].root));
+      continue;
+    }
+    assert(root_brent(f, &i, s, &r) == 0);
+    assert(res[k].reason == rootConverged && res[k].iterations > 0);
+    assert(res[k].root == r.root && res[k].residual == r.residual);
+    assert(res[k].evals == r.evals && res[k].iterations == r.iterations);
+    assert(fabsl(res[k].residual) < 1.0e-12);
+    assert(res4[k].root == r.root && res4[k].iterations == r.iterations);
+  }
+  function_destroy(f);
+
+  /* out of iterations */
+  s->max_iterations = 2;
+  assert(root_brent_batch("cos(x) - a*x**3 + b*x", params, 2, values, brackets, n, s, 0, res) == 0);
+  assert(res[0].reason == rootMaxIterations && res[0].iterations == 2);
+
+  assert(root_brent_batch("cos(x) - ", params, 2, values, brackets, n, s, 0, res) == -1);
+
+  stop_cond_destroy(s);
+  free(values);
+  free(brackets);
+  free(res);
+  free(res4);
+}
+
+/* the roots of func sorted as root_polynomial does */
+static ssize_t poly(const char *func, long double complex **r) {
+  function_t *f = function_create(func);
+  stop_cond_t *s = stop_cond_create(1.0e-16, 500);
+  ssize_t n = root_polynomial_function(f, s, r);
+  function_destroy(f);
+  stop_cond_destroy(s);
+  return n;
+}
+
+void test_polynomial(void) {
+  long double complex *r;
+  ssize_t k;
+
+  assert(poly("x**3 - 6*x**2 + 11*x - 6", &r) == 3);
+  for (k = 0; k < 3; k++)
+    assert(cabsl(r[k] - (k + 1)) < TOLERANCE);
+  free(r);
+
+  /* complex roots of real polynomials come in conjugate pairs */
+  assert(poly("x**2 + 1", &r) == 2);
+  assert(cabsl(r[0] + I) < TOLERANCE && cabsl(r[1] - I) < TOLERANCE);
+  free(r);
+  assert(poly("x**5 - 1", &r) == 5);
+  for (k = 0; k < 5; k++)
+    assert(cabsl(cpowl(r[k], 5) - 1.0) < TOLERANCE);
+  assert(cabsl(r[4] - 1.0) < TOLERANCE);
+  free(r);
+
+  /* wilkinson's polynomial, badly conditioned */
+  long double c[11] = { 1.0 };
+  for (k = 1; k <= 10; k++) {
+    ssize_t j;
+    for (j = k; j > 0; j--)
+      c[j] = c[j-1] - k * c[j];
+    c[0] *= -k;
+  }
+  stop_cond_t *s = stop_cond_create(1.0e-16, 500);
+  assert(root_polynomial(c, 10, s, &r) == 10);
+  for (k = 0; k < 10; k++)
+    assert(cabsl(r[k] - (k + 1)) < 1.0e-9);
+  free(r);
+
+  /* leading zeros are dropped */
+  assert(root_polynomial(c, 1, s, &r) == 1);
+  assert(cabsl(r[0] - (-c[0] / c[1])) < TOLERANCE);
+  free(r);
+  long double z[4] = { 0.0, 0.0, 0.0, 0.0 };
+  assert(root_polynomial(z, 3, s, &r) == -1);
+  stop_cond_destroy(s);
+
+  /* roots at 0 are exact, multiple roots only within ~sqrt(epsilon) */
+  assert(poly("x**4 - x**2", &r) == 4);
+  assert(r[1] == 0.0 && r[2] == 0.0);
+  ASSERT_EQ(creall(r[0]), -1.0);
+  ASSERT_EQ(creall(r[3]), 1.0);
+  free(r);
+  assert(poly("(x - 1)**2 * (x + 2)", &r) == 3);
+  assert(cabsl(r[0] + 2.0) < TOLERANCE);
+  assert(cabsl(r[1] - 1.0) < 1.0e-8 && cabsl(r[2] - 1.0) < 1.0e-8);
+  free(r);
+
+  assert(poly("7", &r) == 0);
+  free(r);
+  r = (long double complex*)1;
+  assert(poly("sin(x)", &r) == -1 && r == NULL);
+  assert(poly("y**2 - 1", &r) == -1);
+}
+
+int main(void) {
+  test_brent();
+  test_stats();
+  test_scan();
+  test_batch();
+  test_polynomial();
+  return 0;
+}
+
+/* vim: set sw=2 sts=2 : */
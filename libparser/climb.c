@@ -0,0 +1,157 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "parser-priv.h"
+
+/* recursive precedence climbing over the same precedence relations used by
+ * the shift-reduce loop. The operator whose right operand is being parsed
+ * plays the part of the top of the stack: a lookahead binding tighter (LT)
+ * is parsed as its operand, anything else ends the operand. Symbols are
+ * appended in evaluation order as their operands are complete, so no
+ * stack of tokens is built */
+
+/* operators nest this deep at most (eg: 2**2**...**2), keeps the C stack
+ * bounded */
+#define CLIMB_MAX_DEPTH 10000
+
+typedef struct {
+  lexer_t *l;
+  pstack_t *out;
+  token_t *bf;   /* lookahead */
+  size_t depth;
+} climb_t;
+
+static char nolexem[] = "";
+static token_t tok_empty = { tokStackEmpty, nolexem };
+
+static int climb_expr(climb_t *c, token_t *ctx);
+
+static void climb_advance(climb_t *c) {
+  c->bf = lexer_advance(c->l);
+}
+
+/* arguments of f, its opening parenthesis is part of the token */
+static int climb_call(climb_t *c, token_t *f) {
+  token_t *ctx = f;
+  size_t nargs = 0;
+  int error;
+
+  climb_advance(c);
+  if (c->bf->lexcomp != tokCParen) {
+    for (;;) {
+      if ((error = climb_expr(c, ctx)))
+        return error;
+      nargs++;
+      /* an argument only ends on EQ, that's ',' or ')' */
+      if (c->bf->lexcomp == tokCParen)
+        break;
+      ctx = c->bf;
+      climb_advance(c);
+    }
+  }
+  climb_advance(c);
+  pstack_push(c->out, symbol_function(c->out->arena, f->lexem, nargs));
+  return 0;
+}
+
+/* an operand: a value, a parenthesized expression, a call or a prefix
+ * operator applied to an operand */
+static int climb_operand(climb_t *c, token_t *ctx) {
+  arena_t *a = c->out->arena;
+  token_t *t = c->bf;
+  int error;
+
+  if (t->lexcomp == tokMinus)
+    t->lexcomp = tokUnaryMinus;
+
+  op_prec_t p = parser_precedence(ctx->lexcomp, t->lexcomp);
+  switch (t->lexcomp) {
+    case tokNumber: case tokTrue: case tokFalse: case tokId:
+    case tokOParen: case tokFunction:
+    case tokUnaryMinus: case tokBitNot: case tokNot:
+      if (p != LT)
+        return parser_syntax_error(p, ctx, t);
+      break;
+    default:
+      if (p != LT && p != EQ && p != GT && p != E0)
+        return parser_syntax_error(p, ctx, t);
+      fprintf(stderr, "syntactic error: expected operand\n");
+      return 7;
+  }
+
+  switch (t->lexcomp) {
+    case tokNumber:
+      pstack_push(c->out, symbol_number(a, strtold(t->lexem, NULL)));
+      climb_advance(c);
+      break;
+    case tokTrue:
+    case tokFalse:
+      pstack_push(c->out, symbol_number(a, t->lexcomp == tokTrue ? 1.0 : 0.0));
+      climb_advance(c);
+      break;
+    case tokId:
+      pstack_push(c->out, symbol_variable(a, t->lexem));
+      climb_advance(c);
+      break;
+    case tokOParen:
+      climb_advance(c);
+      if ((error = climb_expr(c, t)))
+        return error;
+      climb_advance(c);
+      break;
+    case tokFunction:
+      if ((error = climb_call(c, t)))
+        return error;
+      break;
+    default:
+      /* prefix operators, their operand ends the operand */
+      climb_advance(c);
+      if ((error = climb_expr(c, t)))
+        return error;
+      pstack_push(c->out, symbol_operator(a, t->lexcomp));
+      return 0;
+  }
+
+  /* a value can't be followed by another one, ')' relates like a value */
+  if ((p = parser_precedence(tokId, c->bf->lexcomp)) == E3)
+    return parser_syntax_error(p, t, c->bf);
+  return 0;
+}
+
+/* an operand followed by the operators binding tighter than ctx */
+static int climb_expr(climb_t *c, token_t *ctx) {
+  token_t *op;
+  op_prec_t p;
+  int error;
+
+  if (++c->depth > CLIMB_MAX_DEPTH) {
+    fprintf(stderr, "syntactic error: expression nested too deep\n");
+    return 7;
+  }
+  if ((error = climb_operand(c, ctx)))
+    return error;
+
+  while ((p = parser_precedence(ctx->lexcomp, c->bf->lexcomp)) == LT) {
+    op = c->bf;
+    climb_advance(c);
+    if ((error = climb_expr(c, op)))
+      return error;
+    pstack_push(c->out, symbol_operator(c->out->arena, op->lexcomp));
+  }
+  c->depth--;
+
+  /* EQ closes ctx, GT leaves the lookahead to an outer operator */
+  if (p == EQ || p == GT || p == E0)
+    return 0;
+  return parser_syntax_error(p, ctx, c->bf);
+}
+
+int parser_climb(lexer_t *l, pstack_t *partial) {
+  climb_t c = { l, partial, lexer_advance(l), 0 };
+  /* nothing to compile */
+  if (c.bf->lexcomp == tokStackEmpty || c.bf->lexcomp == tokEol)
+    return 0;
+  return climb_expr(&c, &tok_empty);
+}
+
+/* vim: set sw=2 sts=2 : */
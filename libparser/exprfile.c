@@ -0,0 +1,341 @@
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "parser-priv.h"
+#include "parser/exprfile.h"
+
+/* file layout:
+ *   header
+ *   uint64_t offset[count]   where each expression starts
+ *   expression blocks        aligned, pointers stored as block offsets
+ * all integers in host order, the header records enough of the host
+ * layout to reject files we can't use */
+#define EXPRFILE_MAGIC     "aparser"
+#define EXPRFILE_VERSION   2
+#define EXPRFILE_BYTEORDER 0x01020304
+#define EXPRFILE_ALIGN     _Alignof(expr_t)
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t byteorder;
+  uint32_t ldsize;   /* sizeof(long double) */
+  uint32_t symsize;  /* sizeof(symbol_t) */
+  uint64_t count;
+  uint64_t size;     /* of the whole file */
+  uint64_t checksum; /* of everything after the header */
+} exprfile_hdr_t;
+
+struct exprfile_t {
+  char *base;
+  size_t size;
+  size_t count;
+  const uint64_t *offset;
+};
+
+static size_t exprfile_align(size_t n) {
+  return (n + EXPRFILE_ALIGN - 1) & ~(EXPRFILE_ALIGN - 1);
+}
+
+/* FNV-1a over 64bit words, it has to be cheap next to mapping the file */
+static uint64_t exprfile_checksum(const char *p, size_t n) {
+  uint64_t h = 0xcbf29ce484222325ULL, w;
+  for (; n >= sizeof(w); n -= sizeof(w), p += sizeof(w)) {
+    memcpy(&w, p, sizeof(w));
+    h = (h ^ w) * 0x100000001b3ULL;
+  }
+  while (n--)
+    h = (h ^ (unsigned char)*p++) * 0x100000001b3ULL;
+  return h ^ (h >> 32);
+}
+
+
+/* copy e into dst turning its pointers into offsets from the block start,
+ * symbols are rebuilt field by field so padding bytes are always zero */
+static void expr_pack(expr_t *dst, const expr_t *e) {
+  const char *base = (const char*)e;
+  size_t i, n = e->nsyms + e->nbody,
+         tail = offsetof(expr_t, syms) + sizeof(symbol_t) * n;
+
+  dst->size = e->size;
+  dst->nsyms = e->nsyms;
+  dst->nbody = e->nbody;
+  memcpy((char*)dst + tail, base + tail, e->size - tail);
+
+  for (i = 0; i < n; i++) {
+    const symbol_t *s = &e->syms[i];
+    symbol_t *r = &dst->syms[i];
+    r->type = s->type;
+    switch (s->type) {
+      case stNumber:
+        r->number = s->number;
+        break;
+      case stVariable:
+        r->variable = (char*)(uintptr_t)(s->variable - base);
+        break;
+      case stBinOperator:
+      case stUniOperator:
+        r->operator = s->operator;
+        break;
+      case stFunction:
+        r->func.name = (char*)(uintptr_t)(s->func.name - base);
+        r->func.nargs = s->func.nargs;
+        break;
+      case stPolynomial:
+        r->poly.name = (char*)(uintptr_t)(s->poly.name - base);
+        r->poly.degree = s->poly.degree;
+        r->poly.coef = (long double*)(uintptr_t)((const char*)s->poly.coef - base);
+        break;
+      case stPowi:
+        r->exponent = s->exponent;
+        break;
+      case stSqrt:
+        break;
+      case stForm:
+        r->form.kind = s->form.kind;
+        r->form.level = s->form.level;
+        r->form.body = s->form.body;
+        r->form.nbody = s->form.nbody;
+        break;
+      case stBound:
+        r->bound = s->bound;
+        break;
+    }
+  }
+}
+
+int exprfile_write(const char *file, expr_t *const *e, size_t n) {
+  size_t i, size = exprfile_align(sizeof(exprfile_hdr_t) + sizeof(uint64_t) * n);
+
+  for (i = 0; i < n; i++) {
+    if (!e[i]) {
+      fprintf(stderr, "exprfile error: null expression [%zu]\n", i);
+      return 1;
+    }
+    size = exprfile_align(size + e[i]->size);
+  }
+
+  char *buf = (char*)zmalloc(size);
+  exprfile_hdr_t *hdr = (exprfile_hdr_t*)buf;
+  uint64_t *offset = (uint64_t*)(buf + sizeof(exprfile_hdr_t));
+  size_t off = exprfile_align(sizeof(exprfile_hdr_t) + sizeof(uint64_t) * n);
+
+  for (i = 0; i < n; i++) {
+    offset[i] = off;
+    expr_pack((expr_t*)(buf + off), e[i]);
+    off = exprfile_align(off + e[i]->size);
+  }
+
+  memcpy(hdr->magic, EXPRFILE_MAGIC, sizeof(hdr->magic));
+  hdr->version = EXPRFILE_VERSION;
+  hdr->byteorder = EXPRFILE_BYTEORDER;
+  hdr->ldsize = sizeof(long double);
+  hdr->symsize = sizeof(symbol_t);
+  hdr->count = n;
+  hdr->size = size;
+  hdr->checksum = exprfile_checksum(buf + sizeof(exprfile_hdr_t),
+                                    size - sizeof(exprfile_hdr_t));
+
+  FILE *fp = fopen(file, "wb");
+  int err = !fp || fwrite(buf, 1, size, fp) != size;
+  if (fp && fclose(fp))
+    err = 1;
+  if (err)
+    fprintf(stderr, "exprfile error: unable to write %s\n", file);
+  free(buf);
+  return err;
+}
+
+
+/* check that off points to a nul terminated name in the tail of e */
+static char * expr_name(expr_t *e, size_t tail, const char *off) {
+  uintptr_t o = (uintptr_t)off;
+  if (o < tail || o >= e->size || !memchr((char*)e + o, '\0', e->size - o))
+    return NULL;
+  return (char*)e + o;
+}
+
+/* validate the block at e (at most avail bytes) and turn its offsets back
+ * into pointers, return non-zero if it's malformed */
+static int expr_unpack(expr_t *e, size_t avail) {
+  size_t i, j, n, tail;
+
+  if (avail < offsetof(expr_t, syms) || e->size > avail ||
+      e->size < offsetof(expr_t, syms) ||
+      e->nsyms > (e->size - offsetof(expr_t, syms)) / sizeof(symbol_t) ||
+      e->nbody > (e->size - offsetof(expr_t, syms)) / sizeof(symbol_t) - e->nsyms)
+    return 1;
+  n = e->nsyms + e->nbody;
+  tail = offsetof(expr_t, syms) + sizeof(symbol_t) * n;
+
+  for (i = 0; i < n; i++) {
+    symbol_t *s = &e->syms[i];
+    uintptr_t o;
+
+    switch (s->type) {
+      case stNumber:
+      case stPowi:
+      case stSqrt:
+        break;
+
+      case stBinOperator:
+      case stUniOperator:
+        if ((unsigned)s->operator > tokLe)
+          return 1;
+        break;
+
+      case stVariable:
+        if (!(s->variable = expr_name(e, tail, s->variable)))
+          return 1;
+        break;
+
+      case stFunction:
+        if (s->func.nargs > i || !(s->func.name = expr_name(e, tail, s->func.name)))
+          return 1;
+        break;
+
+      case stPolynomial:
+        o = (uintptr_t)s->poly.coef;
+        if (s->poly.degree > POLY_MAX_DEGREE || o < tail ||
+            o % _Alignof(long double) ||
+            o + sizeof(long double) * (s->poly.degree + 1) > e->size)
+          return 1;
+        s->poly.coef = (long double*)((char*)e + o);
+        if (!(s->poly.name = expr_name(e, tail, s->poly.name)))
+          return 1;
+        break;
+
+      /* bodies come after their form, which keeps evaluation finite.
+       * levels are checked below */
+      case stForm:
+        if ((unsigned)s->form.kind > formIntegral || s->form.body <= i ||
+            s->form.body < e->nsyms || s->form.nbody > n - s->form.body ||
+            s->form.level >= FORM_MAX_LEVEL)
+          return 1;
+        s->form.var = NULL;
+        s->form.syms = NULL;
+        break;
+
+      case stBound:
+        if (i < e->nsyms)
+          return 1;
+        break;
+
+      default:
+        return 1;
+    }
+  }
+
+  /* forms see the variables of the ones enclosing them only */
+  for (i = 0; i < n; i++) {
+    const symbol_t *f = &e->syms[i];
+    if (f->type != stForm)
+      continue;
+    if (i < e->nsyms && f->form.level != 0)
+      return 1;
+    for (j = f->form.body; j < f->form.body + f->form.nbody; j++) {
+      const symbol_t *s = &e->syms[j];
+      if ((s->type == stForm && s->form.level != f->form.level + 1) ||
+          (s->type == stBound && s->bound > f->form.level))
+        return 1;
+    }
+  }
+  return 0;
+}
+
+exprfile_t * exprfile_open(const char *file) {
+  struct stat st;
+  int fd = open(file, O_RDONLY);
+
+  if (fd < 0 || fstat(fd, &st) < 0) {
+    fprintf(stderr, "exprfile error: unable to open %s\n", file);
+    if (fd >= 0)
+      close(fd);
+    return NULL;
+  }
+  if ((size_t)st.st_size < sizeof(exprfile_hdr_t)) {
+    fprintf(stderr, "exprfile error: %s is truncated\n", file);
+    close(fd);
+    return NULL;
+  }
+
+  /* private mapping: relocation writes stay in our copy of the pages */
+  size_t size = st.st_size;
+  char *base = (char*)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    fprintf(stderr, "exprfile error: unable to map %s\n", file);
+    return NULL;
+  }
+
+  const exprfile_hdr_t *hdr = (const exprfile_hdr_t*)base;
+  const uint64_t *offset = (const uint64_t*)(base + sizeof(exprfile_hdr_t));
+  const char *error = NULL;
+  size_t i;
+
+  if (memcmp(hdr->magic, EXPRFILE_MAGIC, sizeof(hdr->magic)))
+    error = "not an expression file";
+  else if (hdr->version != EXPRFILE_VERSION)
+    error = "unsupported version";
+  else if (hdr->byteorder != EXPRFILE_BYTEORDER || hdr->ldsize != sizeof(long double) ||
+           hdr->symsize != sizeof(symbol_t))
+    error = "incompatible host layout";
+  else if (hdr->size != size ||
+           hdr->count > (size - sizeof(exprfile_hdr_t)) / sizeof(uint64_t))
+    error = "truncated file";
+  else if (hdr->checksum != exprfile_checksum(base + sizeof(exprfile_hdr_t),
+                                              size - sizeof(exprfile_hdr_t)))
+    error = "checksum mismatch";
+
+  for (i = 0; !error && i < hdr->count; i++) {
+    if (offset[i] < sizeof(exprfile_hdr_t) + sizeof(uint64_t) * hdr->count ||
+        offset[i] >= size || offset[i] % EXPRFILE_ALIGN ||
+        expr_unpack((expr_t*)(base + offset[i]), size - offset[i]))
+      error = "malformed expression";
+  }
+
+  if (error) {
+    fprintf(stderr, "exprfile error: %s: %s\n", file, error);
+    munmap(base, size);
+    return NULL;
+  }
+  mprotect(base, size, PROT_READ);
+
+  exprfile_t *f = (exprfile_t*)zmalloc(sizeof(exprfile_t));
+  f->base = base;
+  f->size = size;
+  f->count = hdr->count;
+  f->offset = offset;
+  return f;
+}
+
+void exprfile_close(exprfile_t *f) {
+  if (!f)
+    return;
+#ifdef _PROFILE_
+  size_t i;
+  for (i = 0; i < f->count; i++)
+    profile_retire(exprfile_get(f, i));
+#endif
+  munmap(f->base, f->size);
+  free(f);
+}
+
+size_t exprfile_count(const exprfile_t *f) {
+  return f ? f->count : 0;
+}
+
+const expr_t * exprfile_get(const exprfile_t *f, size_t i) {
+  if (!f || i >= f->count)
+    return NULL;
+  return (const expr_t*)(f->base + f->offset[i]);
+}
+
+/* vim: set sw=2 sts=2 : */
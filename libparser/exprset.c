@@ -0,0 +1,154 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "parser-priv.h"
+#include "parser/exprset.h"
+
+struct exprset_t {
+  size_t n;
+  expr_t **exprs;
+  int *errors;
+};
+
+/* items are handed to workers in chunks to keep the counter cold */
+#define EXPRSET_CHUNK 16
+
+typedef struct {
+  const char *const *strs;
+  exprset_t *set;
+  atomic_size_t next;
+} exprset_job_t;
+
+static void * exprset_worker(void *arg) {
+  exprset_job_t *job = (exprset_job_t*)arg;
+  exprset_t *set = job->set;
+  arena_t *a = arena_init(0);
+  size_t i, from;
+
+  while ((from = atomic_fetch_add(&job->next, EXPRSET_CHUNK)) < set->n) {
+    for (i = from; i < from + EXPRSET_CHUNK && i < set->n; i++) {
+      set->exprs[i] = parser_compile_str_arena(job->strs[i], a, &set->errors[i]);
+      arena_reset(a);
+    }
+  }
+  arena_destroy(a);
+  return NULL;
+}
+
+exprset_t * exprset_compile(const char *const *strs, size_t n, size_t nthreads) {
+  if (!strs && n)
+    return NULL;
+
+  exprset_t *set = (exprset_t*)zmalloc(sizeof(exprset_t));
+  set->n = n;
+  set->exprs = (expr_t**)zmalloc(sizeof(expr_t*) * (n + 1));
+  set->errors = (int*)zmalloc(sizeof(int) * (n + 1));
+
+  if (nthreads == 0) {
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    nthreads = ncpu > 0 ? ncpu : 1;
+  }
+  if (nthreads > (n + EXPRSET_CHUNK - 1) / EXPRSET_CHUNK)
+    nthreads = (n + EXPRSET_CHUNK - 1) / EXPRSET_CHUNK;
+
+  exprset_job_t job;
+  job.strs = strs;
+  job.set = set;
+  atomic_init(&job.next, 0);
+
+  /* the calling thread is one of the workers */
+  pthread_t *threads = (pthread_t*)zmalloc(sizeof(pthread_t) * (nthreads + 1));
+  size_t i, started = 0;
+  for (i = 1; i < nthreads; i++)
+    if (pthread_create(&threads[started], NULL, exprset_worker, &job) == 0)
+      started++;
+  exprset_worker(&job);
+  for (i = 0; i < started; i++)
+    pthread_join(threads[i], NULL);
+  free(threads);
+
+  return set;
+}
+
+exprset_t * exprset_compile_file(const char *file, size_t nthreads) {
+  FILE *fp = strcmp(file, "-") ? fopen(file, "rb") : stdin;
+  if (!fp) {
+    fprintf(stderr, "exprset error: unable to open %s\n", file);
+    return NULL;
+  }
+
+  /* slurp the file and split it into lines in place */
+  size_t len = 0, cap = 1 << 16, r;
+  char *buf = (char*)xmalloc(cap);
+  while ((r = fread(buf + len, 1, cap - len - 1, fp)) > 0)
+    if ((len += r) == cap - 1)
+      buf = (char*)xrealloc(buf, cap *= 2);
+  if (fp != stdin)
+    fclose(fp);
+  buf[len] = '\0';
+
+  size_t i, n = 0;
+  for (i = 0; i < len; i++)
+    n += buf[i] == '\n';
+  if (len && buf[len-1] != '\n')
+    n++;
+
+  const char **lines = (const char**)zmalloc(sizeof(char*) * (n + 1));
+  char *p = buf;
+  for (i = 0; i < n; i++) {
+    char *eol = strchr(p, '\n');
+    lines[i] = p;
+    if (eol) {
+      *eol = '\0';
+      p = eol + 1;
+    }
+  }
+
+  exprset_t *set = exprset_compile(lines, n, nthreads);
+  free(lines);
+  free(buf);
+  return set;
+}
+
+void exprset_destroy(exprset_t *s) {
+  if (!s)
+    return;
+  size_t i;
+  for (i = 0; i < s->n; i++)
+    parser_destroy_expr(s->exprs[i]);
+  free(s->exprs);
+  free(s->errors);
+  free(s);
+}
+
+size_t exprset_size(const exprset_t *s) {
+  return s ? s->n : 0;
+}
+
+size_t exprset_failed(const exprset_t *s) {
+  size_t i, r = 0;
+  for (i = 0; s && i < s->n; i++)
+    r += s->exprs[i] == NULL;
+  return r;
+}
+
+const expr_t * exprset_get(const exprset_t *s, size_t i) {
+  if (!s || i >= s->n)
+    return NULL;
+  return s->exprs[i];
+}
+
+int exprset_error(const exprset_t *s, size_t i) {
+  if (!s || i >= s->n)
+    return 0;
+  return s->errors[i];
+}
+
+/* vim: set sw=2 sts=2 : */
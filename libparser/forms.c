@@ -0,0 +1,390 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parser-priv.h"
+
+/* reduction forms: series(i, lo, hi, body), product(i, lo, hi, body) and
+ * integral(x, lo, hi, body). Their bodies are moved out of the evaluated
+ * symbols when compiling and get evaluated natively for a whole batch of
+ * values of the bound variable at a time */
+
+/* values of the bound variable evaluated together */
+#define FORM_LANES 64
+/* gauss-legendre panels of integral() */
+#define FORM_PANELS 64
+#define FORM_NODES 8
+/* function call arguments within a body */
+#define FORM_CALL_ARGS 16
+
+static const struct {
+  const char *name;
+  formkind_t kind;
+} forms[] = {
+  { "series(", formSeries },
+  { "product(", formProduct },
+  { "integral(", formIntegral },
+};
+
+const char * form_name(formkind_t kind) {
+  switch (kind) {
+    case formSeries   : return "series";
+    case formProduct  : return "product";
+    case formIntegral : return "integral";
+  }
+  return "?";
+}
+
+static int form_lookup(const char *name, formkind_t *kind) {
+  size_t i;
+  for (i = 0; i < sizeof(forms)/sizeof(forms[0]); i++) {
+    if (!strcmp(name, forms[i].name)) {
+      *kind = forms[i].kind;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+
+/* replace references to the variables bound by the enclosing forms
+ * (vars[0 .. level)) in syms, then optimize the bodies bottom up */
+static int forms_bind(arena_t *a, symbol_t **syms, size_t n,
+                      const char **vars, size_t level) {
+  size_t i, j;
+
+  for (i = 0; i < n; i++) {
+    symbol_t *s = syms[i];
+    if (s->type == stVariable) {
+      /* innermost binding wins */
+      for (j = level; j > 0; j--) {
+        if (!strcmp(s->variable, vars[j-1])) {
+          syms[i] = symbol_bound(a, j - 1);
+          break;
+        }
+      }
+    } else if (s->type == stForm) {
+      if (level == FORM_MAX_LEVEL) {
+        fprintf(stderr, "semantic error: forms nested too deep\n");
+        return 1;
+      }
+      s->form.level = level;
+      vars[level] = s->form.var;
+      if (forms_bind(a, s->form.syms, s->form.nbody, vars, level + 1))
+        return 1;
+      s->form.nbody = semanter_optimize(a, s->form.syms, s->form.nbody);
+    }
+  }
+  return 0;
+}
+
+int semanter_forms(arena_t *a, symbol_t **syms, size_t *n) {
+  /* start of each pending operand, symbols are compacted in place */
+  size_t *from = (size_t*)arena_alloc(a, sizeof(size_t) * (*n + 1));
+  size_t i, depth = 0, o = 0, nforms = 0;
+  formkind_t kind;
+
+  for (i = 0; i < *n; i++) {
+    symbol_t *s = syms[i];
+
+    switch (s->type) {
+      case stNumber: case stVariable: case stPolynomial: case stBound:
+        from[depth++] = o;
+        break;
+      case stBinOperator:
+        if (depth < 2)
+          return 1;
+        depth--;
+        break;
+      case stUniOperator: case stPowi: case stSqrt:
+        if (depth < 1)
+          return 1;
+        break;
+      case stForm:
+        if (depth < 2)
+          return 1;
+        depth--;
+        break;
+
+      case stFunction:
+        if (depth < s->func.nargs)
+          return 1;
+        if (!form_lookup(s->func.name, &kind)) {
+          depth -= s->func.nargs;
+          if (s->func.nargs == 0)
+            from[depth] = o;
+          depth++;
+          break;
+        }
+        if (s->func.nargs != 4) {
+          fprintf(stderr, "semantic error: %s( takes a variable, two bounds "
+                  "and an expression\n", form_name(kind));
+          return 1;
+        }
+        depth -= 4;
+        symbol_t *var = syms[from[depth]];
+        if (from[depth+1] - from[depth] != 1 || var->type != stVariable) {
+          fprintf(stderr, "semantic error: %s( expects a variable first\n",
+                  form_name(kind));
+          return 1;
+        }
+
+        /* move the body out of syms and the bounds down over the variable */
+        s->type = stForm;
+        s->form.kind = kind;
+        s->form.level = 0;
+        s->form.var = var->variable;
+        s->form.nbody = o - from[depth+3];
+        s->form.syms = (symbol_t**)arena_alloc(a, sizeof(symbol_t*) * (s->form.nbody + 1));
+        memcpy(s->form.syms, syms + from[depth+3], sizeof(symbol_t*) * s->form.nbody);
+        memmove(syms + from[depth], syms + from[depth+1],
+                sizeof(symbol_t*) * (from[depth+3] - from[depth+1]));
+        o = from[depth] + from[depth+3] - from[depth+1];
+        depth++;
+        nforms++;
+        break;
+    }
+    syms[o++] = s;
+  }
+  *n = o;
+
+  if (nforms) {
+    const char *vars[FORM_MAX_LEVEL];
+    return forms_bind(a, syms, o, vars, 0);
+  }
+  return 0;
+}
+
+
+typedef long double row_t[FORM_LANES];
+
+/* neumaier's variant of kahan summation */
+typedef struct {
+  long double sum, c;
+} ksum_t;
+
+static void ksum_add(ksum_t *k, long double x) {
+  long double t = k->sum + x;
+  /* infinities would turn the compensation into a nan */
+  if (isfinite(t))
+    k->c += fabsl(k->sum) >= fabsl(x) ? (k->sum - t) + x : (x - t) + k->sum;
+  k->sum = t;
+}
+
+static long double ksum_result(const ksum_t *k) {
+  return isfinite(k->sum) ? k->sum + k->c : k->sum;
+}
+
+/* evaluate the body of f for the nx values of its variable in x, rows is
+ * the operand stack (a row per body symbol). Return non-zero on errors */
+static int form_body(const expr_t *e, const symbol_t *f, const long double *bound,
+                     const long double *x, size_t nx, row_t *rows,
+                     long double *out, hashtbl_t *vars) {
+  const symbol_t *s = e->syms + f->form.body, *end = s + f->form.nbody;
+  long double inner[FORM_MAX_LEVEL], args[FORM_CALL_ARGS], *v, c;
+  size_t d = 0, j, l;
+  builtin_t fn;
+
+  if (f->form.level)
+    memcpy(inner, bound, sizeof(long double) * f->form.level);
+
+  for (; s < end; s++) {
+    long double *r = rows[d], *b;
+
+    switch (s->type) {
+      case stNumber:
+        c = s->number;
+        goto fill;
+
+      case stVariable:
+      case stPolynomial:
+        if (!vars || !(v = (long double*)hashtbl_get(vars,
+                s->type == stVariable ? s->variable : s->poly.name))) {
+          fprintf(stderr, "eval error: uninitialized variable [%s]\n",
+                  s->type == stVariable ? s->variable : s->poly.name);
+          return 1;
+        }
+        c = s->type == stVariable ? *v : poly_eval(s->poly.coef, s->poly.degree, *v);
+        goto fill;
+
+      case stBound:
+        if (s->bound == f->form.level) {
+          memcpy(r, x, sizeof(long double) * nx);
+          d++;
+          break;
+        }
+        c = bound[s->bound];
+      fill:
+        for (l = 0; l < nx; l++)
+          r[l] = c;
+        d++;
+        break;
+
+      case stBinOperator:
+        if (d < 2)
+          goto corrupt;
+        r = rows[d-2];
+        b = rows[--d];
+        switch (s->operator) {
+          case tokPlus:
+            for (l = 0; l < nx; l++) r[l] += b[l];
+            break;
+          case tokMinus:
+            for (l = 0; l < nx; l++) r[l] -= b[l];
+            break;
+          case tokTimes:
+            for (l = 0; l < nx; l++) r[l] *= b[l];
+            break;
+          case tokDivide:
+            for (l = 0; l < nx; l++) r[l] /= b[l];
+            break;
+          default:
+            for (l = 0; l < nx; l++)
+              r[l] = semanter_operator(s->operator, r[l], b[l]);
+            break;
+        }
+        break;
+
+      case stUniOperator:
+        if (d < 1)
+          goto corrupt;
+        r = rows[d-1];
+        for (l = 0; l < nx; l++)
+          r[l] = semanter_operator(s->operator, r[l], 0.0);
+        break;
+
+      case stPowi:
+        if (d < 1)
+          goto corrupt;
+        r = rows[d-1];
+        for (l = 0; l < nx; l++)
+          r[l] = semanter_powi(r[l], s->exponent);
+        break;
+
+      case stSqrt:
+        if (d < 1)
+          goto corrupt;
+        r = rows[d-1];
+        for (l = 0; l < nx; l++)
+          r[l] = sqrtl(r[l]);
+        break;
+
+      case stFunction:
+        if (d < s->func.nargs)
+          goto corrupt;
+        if (!(fn = function_lookup(s->func.name))) {
+          fprintf(stderr, "eval error: unknown function [%s]\n", s->func.name);
+          return 1;
+        }
+        d -= s->func.nargs;
+        {
+          long double *a = args;
+          if (s->func.nargs > FORM_CALL_ARGS)
+            a = (long double*)xmalloc(sizeof(long double) * s->func.nargs);
+          for (l = 0; l < nx; l++) {
+            for (j = 0; j < s->func.nargs; j++)
+              a[j] = rows[d+j][l];
+            rows[d][l] = fn(a, s->func.nargs);
+          }
+          if (a != args)
+            free(a);
+        }
+        d++;
+        break;
+
+      case stForm:
+        if (d < 2)
+          goto corrupt;
+        d -= 2;
+        for (l = 0; l < nx; l++) {
+          inner[f->form.level] = x[l];
+          if (semanter_form(e, s, inner, rows[d][l], rows[d+1][l], vars, &rows[d][l]))
+            return 1;
+        }
+        d++;
+        break;
+    }
+  }
+
+  if (d != 1)
+    goto corrupt;
+  memcpy(out, rows[0], sizeof(long double) * nx);
+  return 0;
+
+corrupt:
+  fprintf(stderr, "eval error: corrupt args stack\n");
+  return 1;
+}
+
+/* 8 point gauss-legendre on [-1, 1] */
+static const long double gl_nodes[FORM_NODES] = {
+  -0.960289856497536231683560868569473L, -0.796666477413626739591553936475831L,
+  -0.525532409916328985817739049189246L, -0.183434642495649804939476142360184L,
+   0.183434642495649804939476142360184L,  0.525532409916328985817739049189246L,
+   0.796666477413626739591553936475831L,  0.960289856497536231683560868569473L,
+};
+static const long double gl_weights[FORM_NODES] = {
+  0.101228536290376259152531354309962L, 0.222381034453374470544355994426241L,
+  0.313706645877887287337962201986601L, 0.362683783378361982965150449277196L,
+  0.362683783378361982965150449277196L, 0.313706645877887287337962201986601L,
+  0.222381034453374470544355994426241L, 0.101228536290376259152531354309962L,
+};
+
+int semanter_form(const expr_t *e, const symbol_t *f, const long double *bound,
+                  long double lo, long double hi, hashtbl_t *vars, long double *r) {
+  long double x[FORM_LANES], y[FORM_LANES], prod = 1.0;
+  ksum_t sum = { 0.0, 0.0 };
+  size_t i, k, l, count;
+  int error = 0;
+
+  if (!isfinite(lo) || !isfinite(hi)) {
+    fprintf(stderr, "eval error: %s( needs finite bounds\n", form_name(f->form.kind));
+    return 1;
+  }
+  if (f->form.kind != formIntegral && hi - lo >= (long double)SIZE_MAX) {
+    fprintf(stderr, "eval error: too many %s( terms\n", form_name(f->form.kind));
+    return 1;
+  }
+
+  row_t *rows = (row_t*)xmalloc(sizeof(row_t) * (f->form.nbody + 1));
+
+  if (f->form.kind == formIntegral) {
+    /* a batch holds FORM_LANES / FORM_NODES whole panels */
+    const long double h = (hi - lo) / FORM_PANELS;
+    for (i = 0; i < FORM_PANELS && !error; i += FORM_LANES / FORM_NODES) {
+      for (k = 0; k < FORM_LANES / FORM_NODES; k++)
+        for (l = 0; l < FORM_NODES; l++)
+          x[k * FORM_NODES + l] = lo + h * (i + k + 0.5L * (1.0L + gl_nodes[l]));
+      error = form_body(e, f, bound, x, FORM_LANES, rows, y, vars);
+      for (l = 0; l < FORM_LANES && !error; l++)
+        ksum_add(&sum, gl_weights[l % FORM_NODES] * y[l]);
+    }
+    *r = ksum_result(&sum) * h / 2.0L;
+  } else {
+    /* the variable is lo + i so it doesn't drift */
+    count = hi >= lo ? (size_t)floorl(hi - lo) + 1 : 0;
+    for (i = 0; i < count && !error; i += k) {
+      k = count - i < FORM_LANES ? count - i : FORM_LANES;
+      for (l = 0; l < k; l++)
+        x[l] = lo + (long double)(i + l);
+      error = form_body(e, f, bound, x, k, rows, y, vars);
+      for (l = 0; l < k && !error; l++) {
+        if (f->form.kind == formSeries)
+          ksum_add(&sum, y[l]);
+        else
+          prod *= y[l];
+      }
+    }
+    *r = f->form.kind == formSeries ? ksum_result(&sum) : prod;
+  }
+
+  free(rows);
+  return error;
+}
+
+/* vim: set sw=2 sts=2 : */
@@ -7,122 +7,151 @@
 #endif
 
 #include <math.h>
+#include <pthread.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "parser-priv.h"
 
-static inline long double pop_arg(list_t *args) {
-  long double *a = (long double*)list_pop(args);
-  long double r = *a;
-  free(a);
-  return r;
-}
-
-long double _max(list_t *args, size_t n) {
-  long double tmp, max = pop_arg(args);
-  while (--n)
-    if ((tmp = pop_arg(args)) > max)
-      max = tmp;
+long double _max(const long double *args, size_t n) {
+  long double max = args[0];
+  size_t i;
+  for (i = 1; i < n; i++)
+    if (args[i] > max)
+      max = args[i];
   return max;
 }
 
-long double _min(list_t *args, size_t n) {
-  long double tmp, min = pop_arg(args);
-  while (--n)
-    if ((tmp = pop_arg(args)) < min)
-      min = tmp;
+long double _min(const long double *args, size_t n) {
+  long double min = args[0];
+  size_t i;
+  for (i = 1; i < n; i++)
+    if (args[i] < min)
+      min = args[i];
   return min;
 }
 
-long double _sum(list_t *args, size_t n) {
+long double _sum(const long double *args, size_t n) {
   long double sum = 0.0;
-  while (n--)
-    sum += pop_arg(args);
+  size_t i;
+  for (i = 0; i < n; i++)
+    sum += args[i];
   return sum;
 }
 
-long double _avg(list_t *args, size_t n) {
+long double _avg(const long double *args, size_t n) {
   return _sum(args, n) / (long double)n;
 }
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wunused-parameter"
-long double _gamma(list_t *args, size_t n) {
-  return tgammal(pop_arg(args));
+long double _gamma(const long double *args, size_t n) {
+  return tgammal(args[0]);
 }
 
-long double _random(list_t *args, size_t n) {
+long double _random(const long double *args, size_t n) {
   return (long double)random();
 }
 
-long double _abs(list_t *args, size_t n) {
-  return fabsl(pop_arg(args));
+long double _abs(const long double *args, size_t n) {
+  return fabsl(args[0]);
 }
 
-long double _sin(list_t *args, size_t n) {
-  return sinl(pop_arg(args));
+long double _sin(const long double *args, size_t n) {
+  return sinl(args[0]);
 }
 
-long double _cos(list_t *args, size_t n) {
-  return cosl(pop_arg(args));
+long double _cos(const long double *args, size_t n) {
+  return cosl(args[0]);
 }
 
-long double _tan(list_t *args, size_t n) {
-  return tanl(pop_arg(args));
+long double _tan(const long double *args, size_t n) {
+  return tanl(args[0]);
 }
 
-long double _asin(list_t *args, size_t n) {
-  return asinl(pop_arg(args));
+long double _asin(const long double *args, size_t n) {
+  return asinl(args[0]);
 }
 
-long double _acos(list_t *args, size_t n) {
-  return acos(pop_arg(args));
+long double _acos(const long double *args, size_t n) {
+  return acos(args[0]);
 }
 
-long double _atan(list_t *args, size_t n) {
-  return atanl(pop_arg(args));
+long double _atan(const long double *args, size_t n) {
+  return atanl(args[0]);
 }
 
-long double _atan2(list_t *args, size_t n) {
-  long double x, y;
-  y = pop_arg(args);
-  x = pop_arg(args);
-  return atan2l(x, y);
+long double _atan2(const long double *args, size_t n) {
+  return atan2l(args[0], args[1]);
 }
 
-long double _log(list_t *args, size_t n) {
-  return logl(pop_arg(args));
+long double _log(const long double *args, size_t n) {
+  return logl(args[0]);
 }
 
-long double _exp(list_t *args, size_t n) {
-  return expl(pop_arg(args));
+long double _exp(const long double *args, size_t n) {
+  return expl(args[0]);
 }
 
-long double _round(list_t *args, size_t n) {
-  return roundl(pop_arg(args));
+long double _round(const long double *args, size_t n) {
+  return roundl(args[0]);
 }
 #pragma GCC diagnostic pop
 
-void register_functions(hashtbl_t *h) {
-  hashtbl_insert(h, "max(", (void*)_max);
-  hashtbl_insert(h, "min(", (void*)_min);
-  hashtbl_insert(h, "sum(", (void*)_sum);
-  hashtbl_insert(h, "avg(", (void*)_avg);
-  hashtbl_insert(h, "random(", (void*)_random);
-  hashtbl_insert(h, "abs(", (void*)_abs);
-
-  hashtbl_insert(h, "sin(", (void*)_sin);
-  hashtbl_insert(h, "cos(", (void*)_cos);
-  hashtbl_insert(h, "tan(", (void*)_tan);
-  hashtbl_insert(h, "asin(", (void*)_asin);
-  hashtbl_insert(h, "acos(", (void*)_acos);
-  hashtbl_insert(h, "atan(", (void*)_atan);
-  hashtbl_insert(h, "atan2(", (void*)_atan2);
-  hashtbl_insert(h, "log(", (void*)_log);
-  hashtbl_insert(h, "exp(", (void*)_exp);
-
-  hashtbl_insert(h, "gamma(", (void*)_gamma);
-  hashtbl_insert(h, "round(", (void*)_round);
+/* known functions and how many arguments they take */
+typedef struct {
+  const char *name;
+  builtin_t f;
+  size_t min, max;
+} fentry_t;
+
+#define VARARGS ((size_t)-1)
+
+static fentry_t builtins[] = {
+  { "max(", _max, 1, VARARGS }, { "min(", _min, 1, VARARGS },
+  { "sum(", _sum, 0, VARARGS }, { "avg(", _avg, 1, VARARGS },
+  { "random(", _random, 0, 0 }, { "abs(", _abs, 1, 1 },
+
+  { "sin(", _sin, 1, 1 }, { "cos(", _cos, 1, 1 }, { "tan(", _tan, 1, 1 },
+  { "asin(", _asin, 1, 1 }, { "acos(", _acos, 1, 1 }, { "atan(", _atan, 1, 1 },
+  { "atan2(", _atan2, 2, 2 }, { "log(", _log, 1, 1 }, { "exp(", _exp, 1, 1 },
+
+  { "gamma(", _gamma, 1, 1 }, { "round(", _round, 1, 1 },
+};
+
+/* filled once and read only afterwards */
+static hashtbl_t *functions = NULL;
+static pthread_once_t functions_once = PTHREAD_ONCE_INIT;
+
+static void register_functions(void) {
+  size_t i;
+  functions = hashtbl_init(NULL, NULL);
+  for (i = 0; i < sizeof(builtins)/sizeof(builtins[0]); i++)
+    hashtbl_insert(functions, builtins[i].name, (void*)&builtins[i]);
+}
+
+static const fentry_t * function_entry(const char *name) {
+  pthread_once(&functions_once, register_functions);
+  return (const fentry_t*)hashtbl_get(functions, name);
+}
+
+builtin_t function_lookup(const char *name) {
+  const fentry_t *e = function_entry(name);
+  return e ? e->f : NULL;
+}
+
+int function_arity(const char *name, size_t nargs) {
+  const fentry_t *e = function_entry(name);
+  if (!e || (nargs >= e->min && nargs <= e->max))
+    return 0;
+  if (e->min == e->max)
+    fprintf(stderr, "syntactic error: %.*s takes %zu argument%s, got %zu\n",
+            (int)strlen(name) - 1, name, e->min, e->min == 1 ? "" : "s", nargs);
+  else
+    fprintf(stderr, "syntactic error: %.*s takes at least %zu argument%s, got %zu\n",
+            (int)strlen(name) - 1, name, e->min, e->min == 1 ? "" : "s", nargs);
+  return 1;
 }
 
 void register_constants(hashtbl_t *h) {
@@ -0,0 +1,514 @@
+/* use GNU_SOURCE for long double constants */
+#ifndef __USE_GNU
+#define __USE_GNU
+#endif
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parser-priv.h"
+#include "parser/interval.h"
+
+/* libm results are within a couple of ulps, widen them some more. Some
+ * operators are evaluated in double precision (pow, acos) so they're
+ * widened relative to that instead */
+#define LIBM_ULPS    4
+#define GAMMA_ULPS   16
+#define DOUBLE_REL   (4 * DBL_EPSILON)
+
+/* gamma has its only positive minimum here */
+#define GAMMA_XMIN   1.46163214496836234126L
+#define GAMMA_YMIN   0.88560319441088870028L
+
+static const ival_t entire = { -INFINITY, INFINITY };
+
+static ival_t ival(long double lo, long double hi) {
+  ival_t r = { lo, hi };
+  if (isnan(lo) || isnan(hi))
+    return entire;
+  return r;
+}
+
+/* move the bounds n ulps outwards */
+static ival_t ival_widen(ival_t r, int n) {
+  while (n--) {
+    r.lo = nextafterl(r.lo, -INFINITY);
+    r.hi = nextafterl(r.hi, INFINITY);
+  }
+  return r;
+}
+
+/* build [lo, hi] out of round to nearest results */
+static ival_t ival_out(long double lo, long double hi) {
+  return ival_widen(ival(lo, hi), 1);
+}
+
+static ival_t ival_widen_rel(ival_t r, long double rel) {
+  if (isfinite(r.lo))
+    r.lo -= fabsl(r.lo) * rel;
+  if (isfinite(r.hi))
+    r.hi += fabsl(r.hi) * rel;
+  return ival_widen(r, 1);
+}
+
+static ival_t ival_clip(ival_t r, long double lo, long double hi) {
+  if (r.lo < lo) r.lo = lo;
+  if (r.hi > hi) r.hi = hi;
+  return r;
+}
+
+static int ival_point(ival_t a) {
+  return a.lo == a.hi;
+}
+
+/* 1 if all of a is true, 0 if all of it is false, -1 if unknown */
+static int ival_truth(ival_t a) {
+  if (a.lo > 0.0 || a.hi < 0.0)
+    return 1;
+  if (a.lo == 0.0 && a.hi == 0.0)
+    return 0;
+  return -1;
+}
+
+static ival_t ival_bool(int t) {
+  return t < 0 ? ival(0.0, 1.0) : ival(t, t);
+}
+
+/* x + y rounded to nearest, *exact is set when no rounding happened */
+static long double ival_sum(long double x, long double y, int *exact) {
+  long double s = x + y, bb = s - x;
+  *exact = !isfinite(s) || (x - (s - bb)) + (y - bb) == 0.0;
+  return s;
+}
+
+/* x + y rounded towards -inf (dir < 0) or +inf */
+static long double ival_add(long double x, long double y, int dir) {
+  int exact;
+  long double s = ival_sum(x, y, &exact);
+  return exact ? s : nextafterl(s, dir < 0 ? -INFINITY : INFINITY);
+}
+
+/* x * y rounded towards -inf (dir < 0) or +inf,
+ * products with a zero bound are 0 even against infinity */
+static long double ival_mulb(long double x, long double y, int dir) {
+  if (x == 0.0 || y == 0.0)
+    return 0.0;
+  long double p = x * y;
+  if (!isfinite(p) || (fabsl(p) >= LDBL_MIN && fmal(x, y, -p) == 0.0))
+    return p;
+  return nextafterl(p, dir < 0 ? -INFINITY : INFINITY);
+}
+
+static ival_t ival_corners(long double a, long double b, long double c, long double d) {
+  return ival(fminl(fminl(a, b), fminl(c, d)), fmaxl(fmaxl(a, b), fmaxl(c, d)));
+}
+
+static ival_t ival_mul(ival_t a, ival_t b) {
+  ival_t lo = ival_corners(ival_mulb(a.lo, b.lo, -1), ival_mulb(a.lo, b.hi, -1),
+                           ival_mulb(a.hi, b.lo, -1), ival_mulb(a.hi, b.hi, -1)),
+         hi = ival_corners(ival_mulb(a.lo, b.lo, 1), ival_mulb(a.lo, b.hi, 1),
+                           ival_mulb(a.hi, b.lo, 1), ival_mulb(a.hi, b.hi, 1));
+  return ival(lo.lo, hi.hi);
+}
+
+static ival_t ival_div(ival_t a, ival_t b) {
+  if (b.lo <= 0.0 && b.hi >= 0.0)
+    return entire;
+  ival_t r = ival_corners(a.lo / b.lo, a.lo / b.hi, a.hi / b.lo, a.hi / b.hi);
+  return ival_widen(r, 1);
+}
+
+/* x**n for an integer n */
+static ival_t ival_powi(ival_t a, long n) {
+  if (n == 0)
+    return ival(1.0, 1.0);
+  if (n < 0)
+    return ival_div(ival(1.0, 1.0), ival_powi(a, -n));
+
+  long double lo = powl(a.lo, n), hi = powl(a.hi, n);
+  ival_t r;
+  if (n % 2 || a.lo >= 0.0)
+    r = ival(lo, hi);
+  else if (a.hi <= 0.0)
+    r = ival(hi, lo);
+  else
+    r = ival(0.0, fmaxl(lo, hi));
+  r = ival_widen(r, LIBM_ULPS);
+  if (n % 2 == 0 && r.lo < 0.0)
+    r.lo = 0.0;
+  return r;
+}
+
+static ival_t ival_pow(ival_t a, ival_t b) {
+  if (ival_point(b) && b.lo == floorl(b.lo) && fabsl(b.lo) < LONG_MAX)
+    return ival_widen_rel(ival_powi(a, (long)b.lo), DOUBLE_REL);
+  if (a.lo < 0.0)
+    return entire;
+  /* monotone in each argument over the positive quadrant */
+  ival_t r = ival_corners(pow(a.lo, b.lo), pow(a.lo, b.hi),
+                          pow(a.hi, b.lo), pow(a.hi, b.hi));
+  r = ival_widen_rel(r, DOUBLE_REL);
+  if (r.lo < 0.0)
+    r.lo = 0.0;
+  return r;
+}
+
+/* % is evaluated in double precision too */
+static ival_t ival_fmod(ival_t a, ival_t b) {
+  if (ival_point(a) && ival_point(b)) {
+    long double y = fmod(a.lo, b.lo);
+    return ival_widen_rel(ival(y, y), DOUBLE_REL);
+  }
+  /* |fmod(x, y)| < |y| and keeps the sign of x */
+  long double m = fmaxl(fabsl(b.lo), fabsl(b.hi));
+  if (isnan(m))
+    return entire;
+  m = fminl(m, fmaxl(fabsl(a.lo), fabsl(a.hi)));
+  return ival_widen_rel(ival(a.lo < 0.0 ? -m : 0.0, a.hi > 0.0 ? m : 0.0), DOUBLE_REL);
+}
+
+/* a contains phase + k*period for some integer k */
+static int ival_hits(ival_t a, long double phase, long double period) {
+  long double tol = 1e-15L * (fabsl(a.lo) + fabsl(a.hi) + 1.0);
+  long double k = ceill((a.lo - tol - phase) / period);
+  return phase + k * period <= a.hi + tol;
+}
+
+/* sin/cos, their maximum is at phase and their minimum half a period away */
+static ival_t ival_periodic(ival_t a, long double (*f)(long double), long double phase) {
+  if (!isfinite(a.lo) || !isfinite(a.hi) || a.hi - a.lo >= 2 * M_PIl)
+    return ival(-1.0, 1.0);
+  long double ylo = f(a.lo), yhi = f(a.hi);
+  ival_t r = ival_widen(ival(fminl(ylo, yhi), fmaxl(ylo, yhi)), LIBM_ULPS);
+  if (ival_hits(a, phase, 2 * M_PIl))
+    r.hi = 1.0;
+  if (ival_hits(a, phase + M_PIl, 2 * M_PIl))
+    r.lo = -1.0;
+  return ival_clip(r, -1.0, 1.0);
+}
+
+static ival_t ival_increasing(ival_t a, long double (*f)(long double), int ulps) {
+  return ival_widen(ival(f(a.lo), f(a.hi)), ulps);
+}
+
+static ival_t ival_atan2(ival_t y, ival_t x) {
+  /* the branch cut lies on the negative x axis */
+  if (x.lo <= 0.0 && y.lo <= 0.0 && y.hi >= 0.0)
+    return ival_widen(ival(-M_PIl, M_PIl), 1);
+  ival_t r = ival_corners(atan2l(y.lo, x.lo), atan2l(y.lo, x.hi),
+                          atan2l(y.hi, x.lo), atan2l(y.hi, x.hi));
+  return ival_widen(r, LIBM_ULPS);
+}
+
+static ival_t ival_gamma(ival_t a) {
+  if (a.lo <= 0.0)
+    return entire;
+  long double glo = tgammal(a.lo), ghi = tgammal(a.hi);
+  ival_t r;
+  if (a.lo >= GAMMA_XMIN)
+    r = ival(glo, ghi);
+  else if (a.hi <= GAMMA_XMIN)
+    r = ival(ghi, glo);
+  else
+    r = ival(GAMMA_YMIN, fmaxl(glo, ghi));
+  return ival_widen(r, GAMMA_ULPS);
+}
+
+
+static ival_t interval_operator(lexcomp_t lc, ival_t a, ival_t b);
+
+static ival_t ival_horner(const long double *c, size_t degree, ival_t x) {
+  ival_t p = ival(c[degree], c[degree]);
+  while (degree--)
+    p = interval_operator(tokPlus, ival_mul(p, x), ival(c[degree], c[degree]));
+  return p;
+}
+
+/* horner's rule suffers from x appearing many times, so also try the
+ * power form and, when the derivative keeps its sign, the end points.
+ * All of them enclose the result so keep their intersection */
+static ival_t ival_poly(const long double *c, size_t degree, ival_t x) {
+  ival_t r = ival_horner(c, degree, x), t, d;
+  size_t k;
+
+  if (degree == 0 || ival_point(x))
+    return r;
+
+  d = ival(0.0, 0.0);
+  for (k = degree; k > 0; k--)
+    d = interval_operator(tokPlus, ival_mul(d, x),
+                          ival_mul(ival(c[k], c[k]), ival(k, k)));
+  if (d.lo > 0.0 || d.hi < 0.0) {
+    ival_t a = ival_horner(c, degree, ival(x.lo, x.lo)),
+           b = ival_horner(c, degree, ival(x.hi, x.hi));
+    t = ival(fminl(a.lo, b.lo), fmaxl(a.hi, b.hi));
+  } else {
+    t = ival(c[0], c[0]);
+    for (k = 1; k <= degree; k++)
+      t = interval_operator(tokPlus, t, ival_mul(ival(c[k], c[k]), ival_powi(x, k)));
+  }
+
+  if (t.lo > r.lo)
+    r.lo = t.lo;
+  if (t.hi < r.hi)
+    r.hi = t.hi;
+  return r;
+}
+
+static ival_t interval_operator(lexcomp_t lc, ival_t a, ival_t b) {
+  int ta, tb;
+
+  switch (lc) {
+    /* mathops */
+    case tokPlus       : return ival(ival_add(a.lo, b.lo, -1), ival_add(a.hi, b.hi, 1));
+    case tokMinus      : return ival(ival_add(a.lo, -b.hi, -1), ival_add(a.hi, -b.lo, 1));
+    case tokUnaryMinus : return ival(-a.hi, -a.lo);
+    case tokTimes      : return ival_mul(a, b);
+    case tokDivide     : return ival_div(a, b);
+    case tokPower      : return ival_pow(a, b);
+    case tokModulo     : return ival_fmod(a, b);
+
+    /* bitops work on ints, only points are worth the trouble */
+    case tokRShift : case tokLShift :
+    case tokBitAnd : case tokBitOr  : case tokBitXor :
+      if (ival_point(a) && ival_point(b))
+        return ival(semanter_operator(lc, a.lo, b.lo), semanter_operator(lc, a.lo, b.lo));
+      return ival(INT_MIN, INT_MAX);
+    case tokBitNot:
+      if (ival_point(a))
+        return ival(semanter_operator(lc, a.lo, 0.0), semanter_operator(lc, a.lo, 0.0));
+      return ival(INT_MIN, INT_MAX);
+
+    /* logicops */
+    case tokNot:
+      ta = ival_truth(a);
+      return ival_bool(ta < 0 ? -1 : !ta);
+    case tokAnd:
+      ta = ival_truth(a); tb = ival_truth(b);
+      return ival_bool(ta == 0 || tb == 0 ? 0 : (ta == 1 && tb == 1 ? 1 : -1));
+    case tokOr:
+      ta = ival_truth(a); tb = ival_truth(b);
+      return ival_bool(ta == 1 || tb == 1 ? 1 : (ta == 0 && tb == 0 ? 0 : -1));
+
+    /* relops */
+    case tokEq:
+      if (ival_point(a) && ival_point(b) && a.lo == b.lo)
+        return ival_bool(1);
+      return ival_bool(a.hi < b.lo || b.hi < a.lo ? 0 : -1);
+    case tokNe:
+      if (ival_point(a) && ival_point(b) && a.lo == b.lo)
+        return ival_bool(0);
+      return ival_bool(a.hi < b.lo || b.hi < a.lo ? 1 : -1);
+    case tokGt : return ival_bool(a.lo > b.hi ? 1 : (a.hi <= b.lo ? 0 : -1));
+    case tokLt : return ival_bool(a.hi < b.lo ? 1 : (a.lo >= b.hi ? 0 : -1));
+    case tokGe : return ival_bool(a.lo >= b.hi ? 1 : (a.hi < b.lo ? 0 : -1));
+    case tokLe : return ival_bool(a.hi <= b.lo ? 1 : (a.lo > b.hi ? 0 : -1));
+
+    /* list explicitly so we get compile errors if we miss an operator */
+    case tokOParen     : case tokCParen  : case tokComma    :
+    case tokNumber     : case tokId      : case tokFunction :
+    case tokAsign      : case tokText    :
+    case tokTrue       : case tokFalse   :
+    case tokStackEmpty : case tokNoMatch : case tokEol      :
+    case tokOMango     : case tokEMango  : case tokCMango   :
+      break;
+  }
+  return ival(0.0, 0.0);
+}
+
+/* builtins over intervals, args in call order. Return non-zero if the
+ * function isn't known */
+static int interval_function(const char *name, const ival_t *args, size_t n, ival_t *r) {
+  size_t i;
+
+  if (n == 0 && strcmp(name, "random("))
+    return 1;
+
+  if (!strcmp(name, "max(") || !strcmp(name, "min(")) {
+    int max = name[1] == 'a';
+    *r = args[0];
+    for (i = 1; i < n; i++) {
+      r->lo = max ? fmaxl(r->lo, args[i].lo) : fminl(r->lo, args[i].lo);
+      r->hi = max ? fmaxl(r->hi, args[i].hi) : fminl(r->hi, args[i].hi);
+    }
+  } else if (!strcmp(name, "sum(") || !strcmp(name, "avg(")) {
+    /* summed in the same order the evaluator does */
+    *r = ival(0.0, 0.0);
+    for (i = 0; i < n; i++)
+      *r = interval_operator(tokPlus, *r, args[i]);
+    if (name[0] == 'a')
+      *r = ival_div(*r, ival(n, n));
+  } else if (!strcmp(name, "random(")) {
+    *r = ival(0.0, RAND_MAX);
+  } else if (!strcmp(name, "abs(")) {
+    const ival_t a = args[0];
+    if (a.lo >= 0.0)
+      *r = a;
+    else if (a.hi <= 0.0)
+      *r = ival(-a.hi, -a.lo);
+    else
+      *r = ival(0.0, fmaxl(-a.lo, a.hi));
+  } else if (!strcmp(name, "sin(")) {
+    *r = ival_periodic(args[0], sinl, M_PI_2l);
+  } else if (!strcmp(name, "cos(")) {
+    *r = ival_periodic(args[0], cosl, 0.0);
+  } else if (!strcmp(name, "tan(")) {
+    const ival_t a = args[0];
+    if (!isfinite(a.lo) || !isfinite(a.hi) || a.hi - a.lo >= M_PIl ||
+        ival_hits(a, M_PI_2l, M_PIl))
+      *r = entire;
+    else
+      *r = ival_increasing(a, tanl, LIBM_ULPS);
+  } else if (!strcmp(name, "asin(") || !strcmp(name, "acos(")) {
+    ival_t a = ival_clip(args[0], -1.0, 1.0);
+    if (a.lo > a.hi)
+      *r = entire;
+    else if (name[1] == 's')
+      *r = ival_clip(ival_increasing(a, asinl, LIBM_ULPS), -M_PI_2l, M_PI_2l);
+    else /* the evaluator uses the double version */
+      *r = ival_widen_rel(ival(acos(a.hi), acos(a.lo)), DOUBLE_REL);
+  } else if (!strcmp(name, "atan(")) {
+    *r = ival_increasing(args[0], atanl, LIBM_ULPS);
+  } else if (!strcmp(name, "atan2(") && n == 2) {
+    *r = ival_atan2(args[0], args[1]);
+  } else if (!strcmp(name, "log(")) {
+    const ival_t a = args[0];
+    if (a.hi <= 0.0)
+      *r = entire;
+    else if (a.lo <= 0.0)
+      *r = ival_widen(ival(-INFINITY, logl(a.hi)), LIBM_ULPS);
+    else
+      *r = ival_increasing(a, logl, LIBM_ULPS);
+  } else if (!strcmp(name, "exp(")) {
+    *r = ival_increasing(args[0], expl, LIBM_ULPS);
+    if (r->lo < 0.0)
+      r->lo = 0.0;
+  } else if (!strcmp(name, "gamma(")) {
+    *r = ival_gamma(args[0]);
+  } else if (!strcmp(name, "round(")) {
+    *r = ival(roundl(args[0].lo), roundl(args[0].hi));
+  } else
+    return 1;
+
+  if (isnan(r->lo) || isnan(r->hi))
+    *r = entire;
+  return 0;
+}
+
+/* builtin constants as intervals, used when ivars doesn't define them.
+ * Same values register_constants stashes for the evaluator */
+static int interval_constant(const char *name, ival_t *r) {
+  long double c;
+  if (!strcmp(name, "pi"))
+    c = M_PI;
+  else if (!strcmp(name, "e"))
+    c = M_E;
+  else if (!strcmp(name, "phi"))
+    c = (1.0L + sqrtl(5.0L)) / 2.0L;
+  else
+    return 1;
+  *r = ival_out(c, c);
+  return 0;
+}
+
+
+int parser_eval_interval(const expr_t *e, ival_t *r, hashtbl_t *ivars) {
+  if (!e || !r) {
+    fprintf(stderr, "eval error: null expression or result var\n");
+    return 1;
+  }
+
+  ival_t *stack = (ival_t*)zmalloc(sizeof(ival_t) * (e->nsyms + 1)), *v, res;
+  size_t i, depth = 0;
+  const char *name;
+
+  for (i = 0; i < e->nsyms; i++) {
+    const symbol_t *s = &e->syms[i];
+
+    switch (s->type) {
+      case stNumber:
+        stack[depth++] = ival(s->number, s->number);
+        break;
+
+      case stVariable:
+      case stPolynomial:
+        name = s->type == stVariable ? s->variable : s->poly.name;
+        if ((v = (ival_t*)hashtbl_get(ivars, name)))
+          stack[depth] = *v;
+        else if (interval_constant(name, &stack[depth])) {
+          fprintf(stderr, "eval error: uninitialized variable [%s]\n", name);
+          goto error;
+        }
+        if (s->type == stPolynomial)
+          stack[depth] = ival_poly(s->poly.coef, s->poly.degree, stack[depth]);
+        depth++;
+        break;
+
+      case stBinOperator:
+        if (depth < 2) {
+          fprintf(stderr, "eval error: missing operand\n");
+          goto error;
+        }
+        depth--;
+        stack[depth-1] = interval_operator(s->operator, stack[depth-1], stack[depth]);
+        break;
+
+      case stUniOperator:
+      case stPowi:
+      case stSqrt:
+        if (depth < 1) {
+          fprintf(stderr, "eval error: missing operand\n");
+          goto error;
+        }
+        v = &stack[depth-1];
+        if (s->type == stUniOperator)
+          *v = interval_operator(s->operator, *v, *v);
+        else if (s->type == stPowi)
+          *v = ival_powi(*v, s->exponent);
+        else if (v->hi < 0.0)
+          *v = entire;
+        else
+          *v = ival_clip(ival_widen(ival(sqrtl(fmaxl(v->lo, 0.0)), sqrtl(v->hi)), 1),
+                         0.0, INFINITY);
+        break;
+
+      case stForm:
+      case stBound:
+        fprintf(stderr, "eval error: reduction forms can't be evaluated over intervals\n");
+        goto error;
+
+      case stFunction:
+        if (depth < s->func.nargs) {
+          fprintf(stderr, "eval error: missing arguments [%s]\n", s->func.name);
+          goto error;
+        }
+        depth -= s->func.nargs;
+        if (interval_function(s->func.name, &stack[depth], s->func.nargs, &res)) {
+          fprintf(stderr, "eval error: unknown function [%s]\n", s->func.name);
+          goto error;
+        }
+        stack[depth++] = res;
+        break;
+    }
+  }
+
+  if (depth != 1) {
+    fprintf(stderr, "eval error: corrupt args stack\n");
+    goto error;
+  }
+  *r = stack[0];
+  free(stack);
+  return 0;
+
+error:
+  free(stack);
+  return 1;
+}
+
+/* vim: set sw=2 sts=2 : */
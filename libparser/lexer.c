@@ -1,15 +1,31 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <sys/types.h>
 
-#include "baas/list.h"
 #include "parser/scanner.h"
 #include "parser/lexer.h"
 
+/* a token and the room its lexem has. Heap tokens stay with their slot
+ * and are rewritten when the slot comes around again */
+typedef struct {
+  token_t *t;
+  size_t room;  /* 0 if t isn't owned by the slot (arena or shifted out) */
+} tslot_t;
+
+#define LEXER_RING_SZ 16
+#define LEXEM_MIN_ROOM 16
+
+/* tokens scanned since the last shift/consume live in a ring of slots
+ * that grows to the longest such run, cur is relative to head and -1
+ * before the first one */
 struct lexer_t {
   scanner_t *s;
-  list_t *tokenized;
-  list_node_t *curtok;
+  tslot_t *ring;
+  size_t cap, head, n;
+  ssize_t cur;
+  int eol;
+  arena_t *arena;
 };
 
 /* utility functions */
@@ -29,8 +45,11 @@ int is_white(char x) {
 }
 
 
-static token_t * tok_maker(const char *base, size_t n) {
-  token_t *t = (token_t*)zmalloc(sizeof(token_t) + n + 1);
+/* tokens come from the arena if given, the heap otherwise */
+static token_t * token_make(arena_t *a, lexcomp_t lc, const char *base, size_t n) {
+  token_t *t = a ? (token_t*)arena_alloc(a, sizeof(token_t) + n + 1)
+                 : (token_t*)xmalloc(sizeof(token_t) + n + 1);
+  t->lexcomp = lc;
   t->lexem = (char*)t + sizeof(token_t); /* piggyback lexem */
   memmove(t->lexem, base, n);
   t->lexem[n] = '\0';
@@ -38,9 +57,7 @@ static token_t * tok_maker(const char *base, size_t n) {
 }
 
 token_t * token_init(lexcomp_t lc, const char *lexem) {
-  token_t *t = tok_maker(lexem, strlen(lexem));
-  t->lexcomp = lc;
-  return t;
+  return token_make(NULL, lc, lexem, strlen(lexem));
 }
 
 void token_destroy(token_t *t) {
@@ -59,8 +76,9 @@ lexcomp_t tokenize_relops(scanner_t *s);
 lexcomp_t tokenize_bitops(scanner_t *s);
 lexcomp_t tokenize_miscops(scanner_t *s);
 
-/* get the next token out of a scanner */
-token_t * lexer_nextitem(scanner_t *s) {
+/* match the next token of a scanner, its lexem is left as the current
+ * slice (nothing for tokNoMatch). Newlines are tokens if eol is set */
+static lexcomp_t lexer_scan(scanner_t *s, int eol) {
   /* try to match longest tokens first */
   static lexcomp_t (*tokenizers[])(scanner_t*) = {
     tokenize_text,
@@ -76,22 +94,42 @@ token_t * lexer_nextitem(scanner_t *s) {
   size_t i;
 
   /* consume all whitespace */
-  while (is_white(scanner_advance(s)));
+  char c;
+  while (is_white(c = scanner_advance(s)) && !(eol && c == '\n'));
   scanner_backup(s);
   scanner_ignore(s);
 
   if (scanner_peek(s) == 0)
-    return token_init(tokStackEmpty, "");
+    return tokStackEmpty;
 
-  for (i = 0; i < sizeof(tokenizers)/sizeof(tokenizers[0]); i++) {
-    if ((lc = tokenizers[i](s)) != tokNoMatch) {
-      token_t *t = (token_t*)scanner_accept(s, (acceptfn)tok_maker);
-      t->lexcomp = lc;
-      return t;
-    }
+  if (eol && scanner_peek(s) == '\n') {
+    scanner_advance(s);
+    return tokEol;
   }
 
-  return token_init(tokNoMatch, "");
+  for (i = 0; i < sizeof(tokenizers)/sizeof(tokenizers[0]); i++)
+    if ((lc = tokenizers[i](s)) != tokNoMatch)
+      return lc;
+
+  return tokNoMatch;
+}
+
+/* the lexem of a scanned lc, accept it */
+static const char * lexer_lexem(scanner_t *s, lexcomp_t lc, size_t *n) {
+  if (lc == tokNoMatch) {
+    *n = 0;
+    return "";
+  }
+  const char *base = scanner_slice(s, n);
+  scanner_ignore(s);
+  return base;
+}
+
+token_t * lexer_nextitem(scanner_t *s) {
+  size_t n;
+  lexcomp_t lc = lexer_scan(s, 0);
+  const char *base = lexer_lexem(s, lc, &n);
+  return token_make(NULL, lc, base, n);
 }
 
 
@@ -99,77 +137,131 @@ lexer_t * lexer_init(scanner_t *s) {
   if (!s)
     return NULL;
   lexer_t *l = (lexer_t*)zmalloc(sizeof(lexer_t));
+  memset(l, 0, sizeof(lexer_t));
   l->s = s;
-  l->tokenized = list_init((free_func_t)token_destroy, NULL);
-  l->curtok = NULL;
+  l->cap = LEXER_RING_SZ;
+  l->ring = (tslot_t*)zmalloc(sizeof(tslot_t) * l->cap);
+  memset(l->ring, 0, sizeof(tslot_t) * l->cap);
+  l->cur = -1;
   return l;
 }
 
 void lexer_destroy(lexer_t *l) {
   if (!l)
     return;
-  list_destroy(l->tokenized);
+  size_t i;
+  for (i = 0; i < l->cap; i++)
+    if (l->ring[i].room)
+      token_destroy(l->ring[i].t);
+  free(l->ring);
   free(l);
 }
 
+void lexer_set_eol(lexer_t *l, int enable) {
+  if (l)
+    l->eol = enable;
+}
+
+void lexer_set_arena(lexer_t *l, arena_t *a) {
+  if (!l || l->n)
+    return;
+  l->arena = a;
+}
+
+static tslot_t * lexer_slot(const lexer_t *l, size_t i) {
+  return &l->ring[(l->head + i) % l->cap];
+}
+
+/* scan the next token into the slot following the last one */
+static token_t * lexer_fill(lexer_t *l) {
+  size_t i, n;
+  if (l->n == l->cap) {
+    /* unroll the ring into a larger one, spare tokens come along */
+    tslot_t *ring = (tslot_t*)zmalloc(sizeof(tslot_t) * 2 * l->cap);
+    for (i = 0; i < l->cap; i++)
+      ring[i] = *lexer_slot(l, i);
+    memset(ring + l->cap, 0, sizeof(tslot_t) * l->cap);
+    free(l->ring);
+    l->ring = ring;
+    l->head = 0;
+    l->cap *= 2;
+  }
+
+  lexcomp_t lc = lexer_scan(l->s, l->eol);
+  const char *base = lexer_lexem(l->s, lc, &n);
+  tslot_t *slot = lexer_slot(l, l->n++);
+  if (l->arena) {
+    if (slot->room)
+      token_destroy(slot->t);
+    slot->t = token_make(l->arena, lc, base, n);
+    slot->room = 0;
+  } else {
+    if (slot->room <= n) {
+      if (slot->room)
+        token_destroy(slot->t);
+      slot->room = n < LEXEM_MIN_ROOM ? LEXEM_MIN_ROOM : n + 1;
+      slot->t = (token_t*)xmalloc(sizeof(token_t) + slot->room);
+      slot->t->lexem = (char*)slot->t + sizeof(token_t);
+    }
+    slot->t->lexcomp = lc;
+    memmove(slot->t->lexem, base, n);
+    slot->t->lexem[n] = '\0';
+  }
+  return slot->t;
+}
+
 token_t * lexer_advance(lexer_t *l) {
   if (!l)
     return NULL;
   /* ingest data */
-  if (!l->curtok) {
-    if (list_size(l->tokenized) == 0)
-      list_queue(l->tokenized, lexer_nextitem(l->s));
-    l->curtok = list_first(l->tokenized);
-    return (token_t*)list_data(l->curtok);
-  }
-  if (!list_next(l->curtok))
-    list_queue(l->tokenized, lexer_nextitem(l->s));
-  l->curtok = list_next(l->curtok);
-  return (token_t*)list_data(l->curtok);
+  if ((size_t)(l->cur + 1) == l->n)
+    lexer_fill(l);
+  return lexer_slot(l, ++l->cur)->t;
 }
 
 token_t * lexer_peek(lexer_t *l) {
   if (!l)
     return NULL;
-  list_node_t *n = l->curtok;
   token_t *t = lexer_advance(l);
-  l->curtok = n;
+  l->cur--;
   return t;
 }
 
 token_t * lexer_current(lexer_t *l) {
-  if (!l)
+  if (!l || l->cur < 0)
     return NULL;
-  return (token_t*)list_data(l->curtok);
+  return lexer_slot(l, l->cur)->t;
 }
 
 token_t * lexer_backup(lexer_t *l) {
-  if (!l || !l->curtok)
+  if (!l || l->cur < 0)
     return NULL;
-  l->curtok = list_prev(l->curtok);
-  if (l->curtok)
-    return (token_t*)list_data(l->curtok);
-  return NULL;
+  return --l->cur < 0 ? NULL : lexer_slot(l, l->cur)->t;
+}
+
+/* drop the tokens up to the current one, their slots are up for reuse */
+static void lexer_drop(lexer_t *l) {
+  l->head = (l->head + l->cur + 1) % l->cap;
+  l->n -= l->cur + 1;
+  l->cur = -1;
 }
 
 /* drop already scanned tokens without destructing them */
 void lexer_shift(lexer_t *l) {
-  if (!l || !l->curtok)
+  if (!l || l->cur < 0)
     return;
-  while (list_first(l->tokenized) != l->curtok)
-    list_pop(l->tokenized);
-  list_pop(l->tokenized);
-  l->curtok = NULL;
+  ssize_t i;
+  /* the tokens are the caller's now */
+  for (i = 0; i <= l->cur; i++)
+    lexer_slot(l, i)->room = 0;
+  lexer_drop(l);
 }
 
 /* like shift but free all used tokens */
 void lexer_consume(lexer_t *l) {
-  if (!l || !l->curtok)
+  if (!l || l->cur < 0)
     return;
-  while (list_first(l->tokenized) != l->curtok)
-    token_destroy((token_t*)list_pop(l->tokenized));
-  token_destroy((token_t*)list_pop(l->tokenized));
-  l->curtok = NULL;
+  lexer_drop(l);
 }
 
 /* vim: set sw=2 sts=2 : */
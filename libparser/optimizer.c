@@ -0,0 +1,79 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <math.h>
+#include <stdlib.h>
+
+#include "parser-priv.h"
+
+/* largest exponent turned into a multiplication chain */
+#define POWI_MAX 64
+
+static int is_number(symbol_t *s) {
+  return s && s->type == stNumber;
+}
+
+/* 1/c is exact only for powers of 2 */
+static int exact_reciprocal(long double c) {
+  int exp;
+  return isfinite(c) && fabsl(frexpl(c, &exp)) == 0.5 && isfinite(1.0 / c);
+}
+
+/* peephole pass over syms (evaluation order):
+ *  - fold operators whose operands are constants
+ *  - x**n with small integer n becomes a multiplication chain
+ *  - x**0.5 becomes a square root
+ *  - x/c becomes x*(1/c) when the reciprocal is exact
+ * a number right before an operator is always its rhs operand */
+static size_t strength_reduce(arena_t *a, symbol_t **syms, size_t n) {
+  size_t i, o = 0;
+
+  for (i = 0; i < n; i++) {
+    symbol_t *s = syms[i],
+             *rhs = o > 0 ? syms[o-1] : NULL,
+             *lhs = o > 1 ? syms[o-2] : NULL;
+
+    if (s->type == stUniOperator && is_number(rhs)) {
+      rhs->number = semanter_operator(s->operator, rhs->number, 0.0);
+      continue;
+    }
+
+    if (s->type == stBinOperator && is_number(rhs)) {
+      long double c = rhs->number;
+
+      if (is_number(lhs)) {
+        lhs->number = semanter_operator(s->operator, lhs->number, c);
+        o--;
+        continue;
+      }
+
+      if (s->operator == tokPower && c == 1.0) {
+        o--;
+        continue;
+      }
+      if (s->operator == tokPower && c == floorl(c) && fabsl(c) <= POWI_MAX) {
+        syms[o-1] = symbol_powi(a, (long)c);
+        continue;
+      }
+      if (s->operator == tokPower && c == 0.5) {
+        syms[o-1] = symbol_sqrt(a);
+        continue;
+      }
+      if (s->operator == tokDivide && exact_reciprocal(c)) {
+        rhs->number = 1.0 / c;
+        s->operator = tokTimes;
+      }
+    }
+
+    syms[o++] = s;
+  }
+  return o;
+}
+
+
+size_t semanter_optimize(arena_t *a, symbol_t **syms, size_t n) {
+  n = polynomial_rewrite(a, syms, n);
+  return strength_reduce(a, syms, n);
+}
+
+/* vim: set sw=2 sts=2 : */
@@ -2,7 +2,8 @@
 #define _PARSER_PRIV_H_
 
 #include "parser/parser.h"
-#include "baas/list.h"
+#include "parser/profile.h"
+#include "baas/arena.h"
 
 /* precedence relation between two operators */
 typedef enum {
@@ -18,15 +19,39 @@ typedef enum {
   E8  /* internal error */
 } op_prec_t;
 
+/* stack of pointers living in the compile arena */
+typedef struct {
+  arena_t *arena;
+  void **items;
+  size_t n, cap;
+} pstack_t;
+
+void pstack_push(pstack_t *s, void *p);
+void * pstack_pop(pstack_t *s);
+void * pstack_peek(const pstack_t *s);
+
 /* return the precedence relation of two operators */
 op_prec_t parser_precedence(lexcomp_t op1, lexcomp_t op2);
 /* adjust token type based on previous one (eg: unary operators) */
 token_t * adjust_token(token_t *t, token_t *prev);
-/* semantic evaluation of the parser's output */
-int semanter_reduce(list_t *stack, list_t *partial);
+/* semantic evaluation of the parser's output, symbols are appended to
+ * partial in evaluation order */
+int semanter_reduce(pstack_t *stack, pstack_t *partial);
+
+/* evaluate an operator on its operands (rhs is ignored for unary ones) */
+long double semanter_operator(lexcomp_t lc, long double lhs, long double rhs);
+/* x**n by repeated squaring */
+long double semanter_powi(long double x, long n);
 
-/* register all known functions for the parser */
-void register_functions(hashtbl_t *h);
+/* builtin functions get their n arguments in call order */
+typedef long double (*builtin_t)(const long double *args, size_t n);
+
+/* find a known function by name (eg: "sin("), NULL if not found */
+builtin_t function_lookup(const char *name);
+/* check a call to a known function takes nargs arguments, unknown ones
+ * pass. Return non-zero (and complain) if it doesn't */
+int function_arity(const char *name, size_t nargs);
+/* register known constants into a symbol table */
 void register_constants(hashtbl_t *h);
 
 /* parsed symbols */
@@ -36,26 +61,125 @@ typedef enum {
   stBinOperator,
   stUniOperator,
   stFunction,
+  stPolynomial,
+  stPowi,      /* integer power of the operand */
+  stSqrt,      /* square root of the operand */
+  stForm,      /* reduction form (eg: series) over its bounds */
+  stBound,     /* variable bound by an enclosing form */
 } symtype_t;
 
+/* reduction forms, f(var, lo, hi, body) */
+typedef enum {
+  formSeries,    /* sum of body for var = lo, lo+1, ... <= hi */
+  formProduct,   /* product of the same */
+  formIntegral,  /* integral of body for var in [lo, hi] */
+} formkind_t;
+
 typedef struct _symbol_t {
   symtype_t type;
   union {
     long double number;
     char *variable;
     lexcomp_t operator;
+    long exponent;
     struct {
       char *name;
       size_t nargs;
     } func;
+    struct {
+      char *name;
+      size_t degree;
+      long double *coef; /* lowest degree first */
+    } poly;
+    struct {
+      formkind_t kind;
+      size_t level;  /* number of enclosing forms */
+      /* compiled: the body is e->syms[body .. body + nbody) */
+      size_t body, nbody;
+      /* while compiling: the bound variable and body symbols */
+      char *var;
+      struct _symbol_t **syms;
+    } form;
+    size_t bound;    /* level of the form binding the variable */
   };
 } symbol_t;
 
-symbol_t * symbol_number(long double d);
-symbol_t * symbol_variable(char *varname);
-symbol_t * symbol_operator(lexcomp_t lc);
-symbol_t * symbol_function(char *funcname, size_t nargs);
-void symbol_destroy(symbol_t *s);
+/* symbols are allocated from the compile arena and die with it */
+symbol_t * symbol_number(arena_t *a, long double d);
+symbol_t * symbol_variable(arena_t *a, const char *varname);
+symbol_t * symbol_operator(arena_t *a, lexcomp_t lc);
+symbol_t * symbol_function(arena_t *a, const char *funcname, size_t nargs);
+symbol_t * symbol_polynomial(arena_t *a, const char *varname,
+                             const long double *coef, size_t degree);
+symbol_t * symbol_powi(arena_t *a, long exponent);
+symbol_t * symbol_sqrt(arena_t *a);
+symbol_t * symbol_bound(arena_t *a, size_t level);
+
+/* compiled expressions are a single block: the symbols in evaluation
+ * order followed by the coefficients and names they point to */
+struct expr_t {
+  size_t size;  /* bytes in the block */
+  size_t nsyms;
+  size_t nbody; /* symbols of form bodies, they follow the nsyms evaluated */
+  symbol_t syms[];
+};
+
+/* copy syms and the bodies of their forms into a new expression block */
+expr_t * expr_build(symbol_t **syms, size_t n);
+/* duplicate an expression block */
+expr_t * expr_copy(const expr_t *e);
+
+/* report the syntactic error p found with st on top of the stack and bf
+ * in the buffer, return its code */
+int parser_syntax_error(op_prec_t p, const token_t *st, const token_t *bf);
+
+/* front ends, they push the symbols of the expression ahead in l to partial
+ * in evaluation order and return the syntactic error code (0 on success) */
+typedef int (*frontend_t)(lexer_t *l, pstack_t *partial);
+/* shift-reduce over the precedence matrix */
+int parser_shift_reduce(lexer_t *l, pstack_t *partial);
+/* recursive precedence climbing over the same relations, the default */
+int parser_climb(lexer_t *l, pstack_t *partial);
+
+/* compile with every intermediate allocation coming from a, err gets the
+ * syntactic error code (0 on success) */
+expr_t * parser_compile_with(frontend_t front, lexer_t *l, arena_t *a, int *err);
+expr_t * parser_compile_arena(lexer_t *l, arena_t *a, int *err);
+expr_t * parser_compile_str_arena(const char *str, arena_t *a, int *err);
+
+/* deepest nesting of reduction forms */
+#define FORM_MAX_LEVEL 8
+
+/* turn calls to reduction forms into stForm symbols, moving their bodies
+ * out of syms (*n is updated). Return non-zero on malformed forms */
+int semanter_forms(arena_t *a, symbol_t **syms, size_t *n);
+/* evaluate the form f of e over [lo, hi], the variables of its enclosing
+ * forms are bound to bound[0 .. f->form.level) */
+int semanter_form(const expr_t *e, const symbol_t *f, const long double *bound,
+                  long double lo, long double hi, hashtbl_t *vars, long double *r);
+/* name of a form as written (eg: "series") */
+const char * form_name(formkind_t kind);
+
+/* optimize the compiled symbols in place, return their new number */
+size_t semanter_optimize(arena_t *a, symbol_t **syms, size_t n);
+
+#ifdef _PROFILE_
+/* account an evaluation of e that took ns */
+void profile_eval(const expr_t *e, uint64_t ns);
+/* e is going away, keep its profile but stop matching its address */
+void profile_retire(const expr_t *e);
+#endif
+
+/* polynomials in a single variable */
+#define POLY_MAX_DEGREE 32
+
+long double poly_horner(const long double *coef, size_t degree, long double x);
+long double poly_estrin(const long double *coef, size_t degree, long double x);
+/* pick the best scheme for the degree */
+long double poly_eval(const long double *coef, size_t degree, long double x);
+/* replace polynomial subexpressions in syms (evaluation order) with
+ * stPolynomial symbols, return the new number of symbols */
+size_t polynomial_rewrite(arena_t *a, symbol_t **syms, size_t n);
 
 #endif /* _PARSER_H_PARSER_H_ */
 
@@ -45,6 +45,7 @@ static ssize_t decode_lexcomp(lexcomp_t lc) {
     case tokId         : return 25;
     case tokFunction   : return 26;
     case tokStackEmpty : return 27;
+    case tokEol        : return 27;
 
     case tokText: case tokAsign: case tokNoMatch:
     case tokOMango: case tokEMango: case tokCMango:
@@ -117,7 +118,7 @@ token_t * adjust_token(token_t *t, token_t *prev) {
       /* misc operators */
       case tokOParen     : case tokFunction :
       case tokComma      : case tokAsign    :
-      case tokStackEmpty :
+      case tokStackEmpty : case tokEol      :
         t->lexcomp = tokUnaryMinus;
         break;
 
@@ -132,82 +133,161 @@ token_t * adjust_token(token_t *t, token_t *prev) {
 }
 
 
-expr_t * parser_compile(lexer_t *l) {
-  if (!l) {
-    return NULL;
+void pstack_push(pstack_t *s, void *p) {
+  if (s->n == s->cap) {
+    size_t cap = s->cap ? 2 * s->cap : 32;
+    void **items = (void**)arena_alloc(s->arena, sizeof(void*) * cap);
+    if (s->n)
+      memcpy(items, s->items, sizeof(void*) * s->n);
+    s->items = items;
+    s->cap = cap;
+  }
+  s->items[s->n++] = p;
+}
+
+void * pstack_pop(pstack_t *s) {
+  return s->n ? s->items[--s->n] : NULL;
+}
+
+void * pstack_peek(const pstack_t *s) {
+  return s->n ? s->items[s->n-1] : NULL;
+}
+
+
+int parser_syntax_error(op_prec_t p, const token_t *st, const token_t *bf) {
+  switch (p) {
+    case E2:
+      fprintf(stderr, "syntactic error: no associativity\n");
+      return 2;
+    case E3:
+      fprintf(stderr, "syntactic error: expected binary operator or eol\n");
+      return 3;
+    case E4:
+      fprintf(stderr, "syntactic error: unbalanced open parenthesis\n");
+      return 4;
+    case E5:
+      fprintf(stderr, "syntactic error: comma only allowed bt function arguments\n");
+      return 5;
+    case E6:
+      fprintf(stderr, "syntactic error: unbalanced closing parenthesis\n");
+      return 6;
+    case E8:
+    default:
+      fprintf(stderr, "syntactic error: stack [%d:%s], buffer [%d:%s]\n",
+              st->lexcomp, st->lexem, bf->lexcomp, bf->lexem);
+      return 8;
   }
+}
 
-  list_t *stack = list_init(NULL, NULL),
-         *partial = list_init(free, NULL),
-         *track= list_init((free_func_t)token_destroy, NULL);
-  token_t *st = token_init(tokStackEmpty, ""),
+
+/* markers pushed on the stack, they're never modified */
+static char nolexem[] = "";
+static token_t tok_empty  = { tokStackEmpty, nolexem },
+               tok_omango = { tokOMango, nolexem },
+               tok_emango = { tokEMango, nolexem };
+
+int parser_shift_reduce(lexer_t *l, pstack_t *partial) {
+  pstack_t stack = { partial->arena, NULL, 0, 0 };
+  token_t *st = &tok_empty,
           *bf = adjust_token(lexer_advance(l), NULL);
 
-  list_push(stack, st); /* initialize the stack to the empty token */
-  list_push(track, st);
+  pstack_push(&stack, st); /* initialize the stack to the empty token */
 
+  lexcomp_t last = tokStackEmpty; /* last token shifted */
   int error = 0;
   op_prec_t p;
   while (error == 0) {
-    st = (token_t*)list_peek_head(stack);
+    st = (token_t*)pstack_peek(&stack);
     switch ((p = parser_precedence(st->lexcomp, bf->lexcomp))) {
       case LT:
       case EQ:
-        st = token_init((p == LT) ? tokOMango : tokEMango, "");
-        list_push(stack, st); list_push(track, st);
-        list_push(stack, bf);
+        /* arguments are counted by their end markers, there's none
+         * to count in an empty argument list (eg: random()) */
+        if (p == LT || last != tokFunction)
+          pstack_push(&stack, (p == LT) ? &tok_omango : &tok_emango);
+        pstack_push(&stack, bf);
+        last = bf->lexcomp;
         bf = adjust_token(lexer_advance(l), bf);
         break;
       case GT:
-        error = semanter_reduce(stack, partial);
+        error = semanter_reduce(&stack, partial);
         break;
-
       case E0:
-        error = -1; break; /* parsing finished */
-      case E2:
-        fprintf(stderr, "syntactic error: no associativity\n");
-        error = 2; break;
-      case E3:
-        fprintf(stderr, "syntactic error: expected binary operator or eol\n");
-        error = 3; break;
-      case E4:
-        fprintf(stderr, "syntactic error: unbalanced open parenthesis\n");
-        error = 4; break;
-      case E5:
-        fprintf(stderr, "syntactic error: comma only allowed bt function arguments\n");
-        error = 5; break;
-      case E6:
-        fprintf(stderr, "syntactic error: unbalanced closing parenthesis\n");
-        error = 6; break;
-      case E8:
-        fprintf(stderr, "syntactic error: stack [%d:%s], buffer [%d:%s]\n",
-                st->lexcomp, st->lexem, bf->lexcomp, bf->lexem);
-        error = 8; break;
+        return 0; /* parsing finished */
+      default:
+        error = parser_syntax_error(p, st, bf);
+        break;
     }
   }
+  return error;
+}
+
+expr_t * parser_compile_with(frontend_t front, lexer_t *l, arena_t *a, int *err) {
+  pstack_t partial = { a, NULL, 0, 0 };
+  int error = front(l, &partial);
+
+  symbol_t **syms = (symbol_t**)partial.items;
+  size_t i, n = partial.n;
+  /* before the forms take their bodies out of syms */
+  for (i = 0; error == 0 && i < n; i++)
+    if (syms[i]->type == stFunction && function_arity(syms[i]->func.name, syms[i]->func.nargs))
+      error = 10;
+  if (error == 0 && semanter_forms(a, syms, &n))
+    error = 9;
+
+  if (err)
+    *err = error;
+  if (error)
+    return NULL;
+  return expr_build(syms, semanter_optimize(a, syms, n));
+}
+
+expr_t * parser_compile_arena(lexer_t *l, arena_t *a, int *err) {
+  return parser_compile_with(parser_climb, l, a, err);
+}
 
-  list_destroy(stack);
-  list_destroy(track);
-  if (error > 0) {
-    list_destroy(partial);
+expr_t * parser_compile(lexer_t *l) {
+  if (!l) {
     return NULL;
   }
-  return (expr_t*)partial;
+  arena_t *a = arena_init(0);
+  expr_t *e = parser_compile_arena(l, a, NULL);
+  arena_destroy(a);
+  return e;
 }
 
 
 void parser_destroy_expr(expr_t *e) {
-  list_destroy((list_t*)e);
+#ifdef _PROFILE_
+  if (e)
+    profile_retire(e);
+#endif
+  free(e);
+}
+
+expr_t * parser_copy_expr(const expr_t *e) {
+  return e ? expr_copy(e) : NULL;
 }
 
 
 /* wrapper functions to avoid constructing everything */
 expr_t * parser_compile_str(const char *str) {
+  arena_t *a = arena_init(0);
+  expr_t *e = parser_compile_str_arena(str, a, NULL);
+  arena_destroy(a);
+  return e;
+}
+
+expr_t * parser_compile_str_arena(const char *str, arena_t *a, int *err) {
   scanner_t *s = scanner_init(str);
   lexer_t *l = lexer_init(s);
-  expr_t *e = parser_compile(l);
+  lexer_set_arena(l, a);
+  expr_t *e = parser_compile_arena(l, a, err);
   lexer_destroy(l);
   scanner_destroy(s);
+#ifdef _PROFILE_
+  parser_profile_label(e, str);
+#endif
   return e;
 }
 
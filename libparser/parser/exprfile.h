@@ -0,0 +1,26 @@
+#ifndef _EXPRFILE_H_
+#define _EXPRFILE_H_
+
+#include "parser.h"
+
+/* on-disk format for compiled expressions: files are mapped and their
+ * expressions used in place, there's no parsing on load. Files are only
+ * portable between hosts with the same long double and pointer layout */
+typedef struct exprfile_t exprfile_t;
+
+/* write n compiled expressions to file, return 0 on success */
+int exprfile_write(const char *file, expr_t *const *e, size_t n);
+
+/* map and validate a file written by exprfile_write, NULL on error */
+exprfile_t * exprfile_open(const char *file);
+/* unmap the file, expressions taken from it are no longer valid */
+void exprfile_close(exprfile_t *f);
+
+/* number of expressions in the file */
+size_t exprfile_count(const exprfile_t *f);
+/* get the i-th expression (don't destroy it), NULL if out of range */
+const expr_t * exprfile_get(const exprfile_t *f, size_t i);
+
+#endif /* _EXPRFILE_H_ */
+
+/* vim: set sw=2 sts=2 : */
@@ -0,0 +1,25 @@
+#ifndef _EXPRSET_H_
+#define _EXPRSET_H_
+
+#include "parser.h"
+
+/* a set of expressions compiled in parallel, kept in input order */
+typedef struct exprset_t exprset_t;
+
+/* compile n strings across nthreads workers (0: one per cpu) */
+exprset_t * exprset_compile(const char *const *strs, size_t n, size_t nthreads);
+/* same for a file ("-" for stdin) holding one expression per line */
+exprset_t * exprset_compile_file(const char *file, size_t nthreads);
+void exprset_destroy(exprset_t *s);
+
+/* number of items and how many of them failed to compile */
+size_t exprset_size(const exprset_t *s);
+size_t exprset_failed(const exprset_t *s);
+/* get the i-th expression, NULL if it didn't compile */
+const expr_t * exprset_get(const exprset_t *s, size_t i);
+/* syntactic error code of the i-th item (0 if it compiled) */
+int exprset_error(const exprset_t *s, size_t i);
+
+#endif /* _EXPRSET_H_ */
+
+/* vim: set sw=2 sts=2 : */
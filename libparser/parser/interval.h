@@ -0,0 +1,21 @@
+#ifndef _INTERVAL_H_
+#define _INTERVAL_H_
+
+#include <baas/hashtbl.h>
+#include "parser.h"
+
+/* closed interval [lo, hi], infinite bounds are allowed */
+typedef struct {
+  long double lo, hi;
+} ival_t;
+
+/* evaluate e over a box: every variable in ivars is an ival_t* and the
+ * result encloses every value e takes for them. Bounds are rounded
+ * outwards so the enclosure holds despite floating point error. When
+ * nothing can be said (eg: division by an interval holding 0) the
+ * result is [-inf, inf] */
+int parser_eval_interval(const expr_t *e, ival_t *r, hashtbl_t *ivars);
+
+#endif /* _INTERVAL_H_ */
+
+/* vim: set sw=2 sts=2 : */
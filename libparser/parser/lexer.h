@@ -1,6 +1,7 @@
 #ifndef _LEXER_H_
 #define _LEXER_H_
 
+#include <baas/arena.h>
 #include "scanner.h"
 
 typedef struct lexer_t lexer_t;
@@ -24,7 +25,7 @@ typedef enum lexcomp_t {
   /* numbers, text, ids... */
   tokNumber, tokText, tokId, tokFunction,
   /* misc */
-  tokStackEmpty, tokNoMatch,
+  tokStackEmpty, tokNoMatch, tokEol,
   /* internal use only */
   tokOMango, tokEMango, tokCMango
 } lexcomp_t;
@@ -45,6 +46,12 @@ token_t * lexer_nextitem(scanner_t *s);
 lexer_t * lexer_init(scanner_t *s);
 void lexer_destroy(lexer_t *l);
 
+/* make newlines significant: emit tokEol for them instead of skipping */
+void lexer_set_eol(lexer_t *l, int enable);
+/* allocate tokens from a instead of the heap, they're released with the
+ * arena. Must be set before scanning and a must outlive the lexer */
+void lexer_set_arena(lexer_t *l, arena_t *a);
+
 token_t * lexer_advance(lexer_t *l);
 token_t * lexer_peek(lexer_t *l);
 token_t * lexer_current(lexer_t *l);
@@ -1,6 +1,7 @@
 #ifndef _PARSER_H_
 #define _PARSER_H_
 
+#include <sys/types.h>
 #include <baas/hashtbl.h>
 #include "lexer.h"
 
@@ -11,12 +12,19 @@ expr_t * parser_compile(lexer_t *s);
 expr_t * parser_compile_str(const char *str);
 /* destructor for compiled expressions */
 void parser_destroy_expr(expr_t *e);
+/* independent copy of a compiled expression (eg: one per thread) */
+expr_t * parser_copy_expr(const expr_t *e);
 
 /* evaluate a compiled expression using variables from vars */
 int parser_eval(const expr_t *e, long double *r, hashtbl_t *vars);
 /* quick-evaluate an expression, only internal constants are available */
 long double parser_qeval(const char *expr);
 
+/* check if e is a polynomial in a single variable, return its degree or -1.
+ * var points into e (NULL if constant) and coef gets the coefficients
+ * lowest degree first (user must free) */
+ssize_t parser_polynomial(const expr_t *e, const char **var, long double **coef);
+
 #endif /* _PARSER_H_ */
 
 /* vim: set sw=2 sts=2 : */
@@ -0,0 +1,34 @@
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include "parser.h"
+
+/* evaluation profiles of compiled expressions. They're only collected when
+ * the library is built with -D_PROFILE_ (cmake -DPARSER_PROFILE=ON),
+ * otherwise parser_eval carries no instrumentation and these are no-ops */
+
+/* non-zero if the library collects profiles */
+int parser_profile_enabled(void);
+
+/* name e in the dump, expressions compiled from strings are named after
+ * their source already */
+void parser_profile_label(const expr_t *e, const char *label);
+
+/* monotonic clock in nanoseconds */
+uint64_t parser_profile_clock(void);
+/* account an outer call (eg: function_eval) on e that took ns */
+void parser_profile_call(const expr_t *e, uint64_t ns);
+
+/* write one json object per evaluated expression (destroyed ones too):
+ *  {"label": ..., "evals": n, "ns": t, "calls": n, "call_ns": t,
+ *   "symbols": n, "depth": d, "ops": {"+": n, ...}, "funcs": {"sin": n}}
+ * return the number of objects written */
+size_t parser_profile_dump(FILE *out);
+/* forget everything collected so far */
+void parser_profile_reset(void);
+
+#endif /* _PROFILE_H_ */
+
+/* vim: set sw=2 sts=2 : */
@@ -0,0 +1,27 @@
+#ifndef _REGVM_H_
+#define _REGVM_H_
+
+#include <baas/hashtbl.h>
+#include "parser.h"
+
+/* register machine backend for compiled expressions:
+ * subexpression results live in a register file and every instruction
+ * names its source and destination slots, constants and variables are
+ * addressed in place so they don't need load instructions */
+typedef struct regvm_t regvm_t;
+
+/* translate a compiled expression into a register program */
+regvm_t * regvm_compile(const expr_t *e);
+/* destructor for register programs */
+void regvm_destroy(regvm_t *p);
+
+/* evaluate a register program using variables from vars */
+int regvm_eval(const regvm_t *p, long double *r, hashtbl_t *vars);
+
+/* program stats: number of instructions and registers used */
+size_t regvm_instructions(const regvm_t *p);
+size_t regvm_registers(const regvm_t *p);
+
+#endif /* _REGVM_H_ */
+
+/* vim: set sw=2 sts=2 : */
@@ -28,6 +28,8 @@ void * scanner_accept(scanner_t *s, acceptfn f);
 void scanner_ignore(scanner_t *s);
 /* apply the given function on the current slice without accepting */
 void * scanner_apply(scanner_t *s, acceptfn f);
+/* get the current slice without accepting (not nul terminated) */
+const char * scanner_slice(scanner_t *s, size_t *len);
 
 #endif /* _SCANNER_H_ */
 
@@ -0,0 +1,357 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parser-priv.h"
+
+/* p(x) = c[0] + x * (c[1] + x * (c[2] + ...)) */
+long double poly_horner(const long double *c, size_t degree, long double x) {
+  long double r = c[degree];
+  while (degree--)
+    r = r * x + c[degree];
+  return r;
+}
+
+/* evaluate pairs (c[i] + c[i+1] * x) then combine them pairwise with
+ * x^2, x^4, ... the products at each level are independent of each other */
+long double poly_estrin(const long double *c, size_t degree, long double x) {
+  long double t[POLY_MAX_DEGREE / 2 + 1];
+  size_t i, n = degree + 1;
+
+  for (i = 0; i + 1 < n; i += 2)
+    t[i/2] = c[i] + c[i+1] * x;
+  if (n & 1)
+    t[n/2] = c[n-1];
+
+  for (n = (n + 1) / 2; n > 1; n = (n + 1) / 2) {
+    x *= x;
+    for (i = 0; i + 1 < n; i += 2)
+      t[i/2] = t[i] + t[i+1] * x;
+    if (n & 1)
+      t[n/2] = t[n-1];
+  }
+  return t[0];
+}
+
+long double poly_eval(const long double *c, size_t degree, long double x) {
+  if (degree < 8)
+    return poly_horner(c, degree, x);
+  return poly_estrin(c, degree, x);
+}
+
+
+/* a pending operand while walking the expression in evaluation order */
+typedef struct {
+  size_t from;      /* index of its first symbol in the output */
+  int ispoly;       /* is a polynomial (or a constant) */
+  const char *var;  /* NULL for constants */
+  size_t degree;
+  long double coef[POLY_MAX_DEGREE + 1];
+  size_t cost;      /* rough cost of evaluating the original symbols */
+} pterm_t;
+
+/* operator costs, pow dwarfs the rest */
+#define COST_OP  1
+#define COST_POW 8
+
+static void pterm_opaque(pterm_t *t, size_t from) {
+  t->from = from;
+  t->ispoly = 0;
+  t->var = NULL;
+  t->degree = 0;
+  t->cost = 0;
+}
+
+static void pterm_number(pterm_t *t, size_t from, long double d) {
+  pterm_opaque(t, from);
+  t->ispoly = 1;
+  t->coef[0] = d;
+}
+
+static void pterm_poly(pterm_t *t, size_t from, const char *var,
+                       const long double *coef, size_t degree) {
+  pterm_opaque(t, from);
+  t->ispoly = 1;
+  t->var = var;
+  t->degree = degree;
+  memcpy(t->coef, coef, sizeof(long double) * (degree + 1));
+}
+
+/* drop leading zero coefficients */
+static void pterm_trim(pterm_t *t) {
+  while (t->degree > 0 && t->coef[t->degree] == 0.0)
+    t->degree--;
+}
+
+static int pterm_mul(pterm_t *a, const pterm_t *b) {
+  long double r[POLY_MAX_DEGREE + 1];
+  size_t i, j;
+  if (a->degree + b->degree > POLY_MAX_DEGREE)
+    return 1;
+  memset(r, 0, sizeof(long double) * (a->degree + b->degree + 1));
+  for (i = 0; i <= a->degree; i++)
+    for (j = 0; j <= b->degree; j++)
+      r[i+j] += a->coef[i] * b->coef[j];
+  a->degree += b->degree;
+  memcpy(a->coef, r, sizeof(long double) * (a->degree + 1));
+  return 0;
+}
+
+/* raise a to the n-th power, return non-zero if the degree gets too high */
+static int pterm_pow(pterm_t *a, size_t n) {
+  pterm_t base = *a;
+  if (a->degree * n > POLY_MAX_DEGREE)
+    return 1;
+  a->degree = 0;
+  a->coef[0] = 1.0;
+  while (n-- > 0)
+    pterm_mul(a, &base);
+  return 0;
+}
+
+/* combine a <op> b into a, return non-zero if the result isn't polynomial */
+static int pterm_combine(pterm_t *a, const pterm_t *b, lexcomp_t op) {
+  size_t i;
+
+  if (!a->ispoly || !b->ispoly)
+    return 1;
+  if (a->var && b->var && strcmp(a->var, b->var))
+    return 1;
+
+  /* constant operands are evaluated just like the interpreter would */
+  if (!a->var && !b->var) {
+    a->coef[0] = semanter_operator(op, a->coef[0], b->coef[0]);
+    return 0;
+  }
+
+  switch (op) {
+    case tokPlus:
+    case tokMinus:
+      for (i = a->degree + 1; i <= b->degree; i++)
+        a->coef[i] = 0.0;
+      if (b->degree > a->degree)
+        a->degree = b->degree;
+      for (i = 0; i <= b->degree; i++)
+        a->coef[i] += op == tokPlus ? b->coef[i] : -b->coef[i];
+      break;
+
+    case tokTimes:
+      if (pterm_mul(a, b))
+        return 1;
+      break;
+
+    case tokDivide:
+      if (b->var || b->coef[0] == 0.0)
+        return 1;
+      for (i = 0; i <= a->degree; i++)
+        a->coef[i] /= b->coef[0];
+      break;
+
+    case tokPower: {
+      long double n = b->coef[0];
+      if (b->var || n < 0.0 || n > POLY_MAX_DEGREE || n != floorl(n) ||
+          pterm_pow(a, (size_t)n))
+        return 1;
+      break;
+    }
+
+    default:
+      return 1;
+  }
+  if (!a->var)
+    a->var = b->var;
+  pterm_trim(a);
+  return 0;
+}
+
+/* replace the symbols of t, out[from..end), with a polynomial if that's
+ * cheaper to evaluate. Symbols after end are shifted down */
+static void pterm_rewrite(arena_t *a, pterm_t *t, size_t end,
+                          symbol_t **out, size_t *nout) {
+  if (!t->ispoly || !t->var || t->cost <= 2 * t->degree)
+    return;
+  out[t->from] = symbol_polynomial(a, t->var, t->coef, t->degree);
+  memmove(out + t->from + 1, out + end, sizeof(symbol_t*) * (*nout - end));
+  *nout -= end - t->from - 1;
+  t->cost = 2 * t->degree;
+}
+
+/* max number of operands a walk over syms will need */
+static size_t polynomial_depth(symbol_t **syms, size_t n) {
+  size_t i, depth = 0, max = 0;
+  for (i = 0; i < n; i++) {
+    switch (syms[i]->type) {
+      case stNumber: case stVariable: case stPolynomial: case stBound:
+        depth++;
+        break;
+      case stBinOperator: case stForm:
+        depth -= depth ? 1 : 0;
+        break;
+      case stUniOperator: case stPowi: case stSqrt:
+        break;
+      case stFunction:
+        depth -= depth < syms[i]->func.nargs ? depth : syms[i]->func.nargs;
+        depth++;
+        break;
+    }
+    if (depth > max)
+      max = depth;
+  }
+  return max;
+}
+
+/* walk symbols in evaluation order tracking which operands are polynomials,
+ * if out is given rewrite them as they get used by non-polynomial symbols.
+ * return the number of operands left on the stack or -1 on malformed input */
+static ssize_t polynomial_walk(arena_t *a, symbol_t **syms, size_t n,
+                               pterm_t *stack, symbol_t **out, size_t *nout) {
+  size_t i, j, depth = 0, o = 0;
+  pterm_t *t;
+
+  for (i = 0; i < n; i++) {
+    symbol_t *s = syms[i];
+
+    switch (s->type) {
+      case stNumber:
+        pterm_number(&stack[depth++], o, s->number);
+        break;
+
+      case stVariable: {
+        const long double x[] = { 0.0, 1.0 };
+        pterm_poly(&stack[depth++], o, s->variable, x, 1);
+        break;
+      }
+
+      case stPolynomial:
+        pterm_poly(&stack[depth++], o, s->poly.name, s->poly.coef, s->poly.degree);
+        stack[depth-1].cost = 2 * s->poly.degree;
+        break;
+
+      case stBound:
+        pterm_opaque(&stack[depth++], o);
+        break;
+
+      case stUniOperator:
+      case stPowi:
+      case stSqrt:
+        if (depth < 1)
+          goto malformed;
+        t = &stack[depth-1];
+        if (s->type == stUniOperator && s->operator == tokUnaryMinus && t->ispoly) {
+          for (j = 0; j <= t->degree; j++)
+            t->coef[j] = -t->coef[j];
+          t->cost += COST_OP;
+        } else if (s->type == stPowi && t->ispoly && t->var && s->exponent >= 0 &&
+                   pterm_pow(t, s->exponent) == 0) {
+          /* the optimizer turns small integer powers into powi */
+          pterm_trim(t);
+          t->cost += COST_POW;
+        } else {
+          if (out)
+            pterm_rewrite(a, t, o, out, &o);
+          pterm_opaque(t, t->from);
+        }
+        break;
+
+      case stBinOperator:
+        if (depth < 2)
+          goto malformed;
+        t = &stack[depth-2];
+        if (pterm_combine(t, &stack[depth-1], s->operator) == 0) {
+          t->cost += stack[depth-1].cost +
+                     (s->operator == tokPower ? COST_POW : COST_OP);
+        } else {
+          /* rewrite the rhs first, its symbols come last */
+          if (out) {
+            pterm_rewrite(a, &stack[depth-1], o, out, &o);
+            pterm_rewrite(a, t, stack[depth-1].from, out, &o);
+          }
+          pterm_opaque(t, t->from);
+        }
+        depth--;
+        break;
+
+      case stFunction:
+      case stForm: {
+        /* forms take their two bounds */
+        size_t nargs = s->type == stForm ? 2 : s->func.nargs;
+        if (depth < nargs)
+          goto malformed;
+        for (j = depth; out && j > depth - nargs; j--)
+          pterm_rewrite(a, &stack[j-1], j == depth ? o : stack[j].from, out, &o);
+        depth -= nargs;
+        t = &stack[depth++];
+        pterm_opaque(t, nargs ? t->from : o);
+        break;
+      }
+    }
+
+    if (out) {
+      out[o++] = s;
+      syms[i] = NULL;
+    }
+  }
+
+  if (out && depth == 1)
+    pterm_rewrite(a, &stack[0], o, out, &o);
+  if (nout)
+    *nout = o;
+  return depth;
+
+malformed:
+  if (nout)
+    *nout = o;
+  return -1;
+}
+
+
+size_t polynomial_rewrite(arena_t *a, symbol_t **syms, size_t n) {
+  size_t i, nout = 0;
+  symbol_t **out = (symbol_t**)arena_alloc(a, sizeof(symbol_t*) * (n + 1));
+  pterm_t *stack = (pterm_t*)arena_alloc(a, sizeof(pterm_t) * (polynomial_depth(syms, n) + 1));
+
+  polynomial_walk(a, syms, n, stack, out, &nout);
+
+  /* on malformed input leave the remaining symbols untouched */
+  for (i = 0; i < n; i++)
+    if (syms[i])
+      out[nout++] = syms[i];
+  memcpy(syms, out, sizeof(symbol_t*) * nout);
+  return nout;
+}
+
+
+ssize_t parser_polynomial(const expr_t *e, const char **var, long double **coef) {
+  if (!e)
+    return -1;
+  size_t i, n = e->nsyms;
+  ssize_t degree = -1;
+  symbol_t **syms = (symbol_t**)zmalloc(sizeof(symbol_t*) * (n + 1)),
+           *copy = (symbol_t*)zmalloc(sizeof(symbol_t) * (n + 1));
+
+  memcpy(copy, e->syms, sizeof(symbol_t) * n);
+  for (i = 0; i < n; i++)
+    syms[i] = &copy[i];
+  pterm_t *stack = (pterm_t*)zmalloc(sizeof(pterm_t) * (polynomial_depth(syms, n) + 1));
+
+  if (polynomial_walk(NULL, syms, n, stack, NULL, NULL) == 1 && stack[0].ispoly) {
+    degree = stack[0].degree;
+    if (var)
+      *var = stack[0].var;
+    if (coef) {
+      *coef = (long double*)zmalloc(sizeof(long double) * (degree + 1));
+      memcpy(*coef, stack[0].coef, sizeof(long double) * (degree + 1));
+    }
+  }
+
+  free(stack);
+  free(copy);
+  free(syms);
+  return degree;
+}
+
+/* vim: set sw=2 sts=2 : */
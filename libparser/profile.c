@@ -0,0 +1,322 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "parser-priv.h"
+#include "parser/profile.h"
+
+uint64_t parser_profile_clock(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+#ifdef _PROFILE_
+
+/* symbols that aren't operators get their own slots after the lexcomps */
+enum { opPolynomial = tokCMango + 1, opPowi, opSqrt,
+       opSeries, opProduct, opIntegral, opCount };
+
+static const char *op_names[opCount] = {
+  [tokPlus] = "+", [tokMinus] = "-", [tokUnaryMinus] = "neg",
+  [tokTimes] = "*", [tokDivide] = "/", [tokModulo] = "%", [tokPower] = "**",
+  [tokRShift] = ">>", [tokLShift] = "<<", [tokBitAnd] = "&", [tokBitOr] = "|",
+  [tokBitXor] = "^", [tokBitNot] = "~", [tokNot] = "not", [tokAnd] = "and",
+  [tokOr] = "or", [tokEq] = "==", [tokNe] = "!=", [tokGt] = ">", [tokLt] = "<",
+  [tokGe] = ">=", [tokLe] = "<=",
+  [opPolynomial] = "poly", [opPowi] = "powi", [opSqrt] = "sqrt",
+  [opSeries] = "series", [opProduct] = "product", [opIntegral] = "integral",
+};
+
+typedef struct {
+  char *name;
+  size_t n;
+} fcount_t;
+
+/* every evaluation runs all the symbols of an expression once, so the
+ * per symbol counts and the stack depth are worked out up front and
+ * only evaluations and time are accounted at run time */
+typedef struct {
+  const expr_t *e;    /* NULL once the expression is destroyed */
+  char *label;
+  size_t evals, calls;
+  uint64_t ns, call_ns;
+  size_t nsyms, depth;
+  size_t ops[opCount];
+  fcount_t *funcs;
+  size_t nfuncs;
+} precord_t;
+
+/* records by expression address, open addressing with linear probing */
+static struct {
+  pthread_mutex_t lock;
+  precord_t **all;
+  size_t n, cap;
+  precord_t **slots;
+  size_t nslots, used;
+} prof = { PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0, NULL, 0, 0 };
+
+/* marks a slot whose record was retired */
+static precord_t tombstone;
+
+static size_t profile_hash(const expr_t *e) {
+  uint64_t h = (uint64_t)(uintptr_t)e * 0x9e3779b97f4a7c15ull;
+  return (size_t)(h >> 32);
+}
+
+static precord_t ** profile_slot(const expr_t *e) {
+  size_t i = profile_hash(e) & (prof.nslots - 1);
+  while (prof.slots[i] && (prof.slots[i] == &tombstone || prof.slots[i]->e != e))
+    i = (i + 1) & (prof.nslots - 1);
+  return &prof.slots[i];
+}
+
+/* rebuild the table without tombstones, growing it when half full */
+static void profile_rehash(void) {
+  size_t i, live = 0;
+  for (i = 0; i < prof.n; i++)
+    live += prof.all[i]->e != NULL;
+
+  free(prof.slots);
+  prof.nslots = 64;
+  while (prof.nslots < 4 * (live + 1))
+    prof.nslots <<= 1;
+  prof.slots = (precord_t**)zmalloc(sizeof(precord_t*) * prof.nslots);
+  prof.used = live;
+  for (i = 0; i < prof.n; i++)
+    if (prof.all[i]->e)
+      *profile_slot(prof.all[i]->e) = prof.all[i];
+}
+
+static char * profile_strdup(const char *s) {
+  size_t n = strlen(s) + 1;
+  return (char*)memcpy(zmalloc(n), s, n);
+}
+
+static void profile_count_func(precord_t *p, const char *name) {
+  size_t i;
+  for (i = 0; i < p->nfuncs; i++) {
+    if (!strcmp(p->funcs[i].name, name)) {
+      p->funcs[i].n++;
+      return;
+    }
+  }
+  p->funcs = (fcount_t*)xrealloc(p->funcs, sizeof(fcount_t) * (p->nfuncs + 1));
+  p->funcs[p->nfuncs].name = profile_strdup(name);
+  p->funcs[p->nfuncs++].n = 1;
+}
+
+static precord_t * profile_record(const expr_t *e) {
+  size_t i, depth = 0;
+  precord_t **slot, *p;
+
+  if (2 * (prof.used + 1) > prof.nslots)
+    profile_rehash();
+  slot = profile_slot(e);
+  if (*slot)
+    return *slot;
+
+  p = (precord_t*)zmalloc(sizeof(precord_t));
+  p->e = e;
+  p->nsyms = e->nsyms;
+  for (i = 0; i < e->nsyms; i++) {
+    const symbol_t *s = &e->syms[i];
+    switch (s->type) {
+      case stNumber: case stVariable:
+        depth++;
+        break;
+      case stPolynomial:
+        p->ops[opPolynomial]++;
+        depth++;
+        break;
+      case stBinOperator:
+        p->ops[s->operator]++;
+        depth -= depth ? 1 : 0;
+        break;
+      case stForm:
+        /* the body's symbols aren't counted, they run a variable number of times */
+        p->ops[opSeries + s->form.kind]++;
+        depth -= depth ? 1 : 0;
+        break;
+      case stBound:
+        break;
+      case stUniOperator:
+        p->ops[s->operator]++;
+        break;
+      case stPowi:
+        p->ops[opPowi]++;
+        break;
+      case stSqrt:
+        p->ops[opSqrt]++;
+        break;
+      case stFunction:
+        profile_count_func(p, s->func.name);
+        depth -= depth < s->func.nargs ? depth : s->func.nargs;
+        depth++;
+        break;
+    }
+    if (depth > p->depth)
+      p->depth = depth;
+  }
+
+  if (prof.n == prof.cap) {
+    prof.cap = prof.cap ? 2 * prof.cap : 64;
+    prof.all = (precord_t**)xrealloc(prof.all, sizeof(precord_t*) * prof.cap);
+  }
+  prof.all[prof.n++] = p;
+  prof.used++;
+  *slot = p;
+  return p;
+}
+
+static void profile_free(precord_t *p) {
+  size_t i;
+  for (i = 0; i < p->nfuncs; i++)
+    free(p->funcs[i].name);
+  free(p->funcs);
+  free(p->label);
+  free(p);
+}
+
+void profile_eval(const expr_t *e, uint64_t ns) {
+  pthread_mutex_lock(&prof.lock);
+  precord_t *p = profile_record(e);
+  p->evals++;
+  p->ns += ns;
+  pthread_mutex_unlock(&prof.lock);
+}
+
+void profile_retire(const expr_t *e) {
+  size_t i;
+  pthread_mutex_lock(&prof.lock);
+  precord_t **slot = prof.nslots ? profile_slot(e) : NULL;
+  if (slot && *slot) {
+    precord_t *p = *slot;
+    *slot = &tombstone;
+    p->e = NULL;
+    /* keep what's been evaluated for the dump */
+    if (p->evals == 0 && p->calls == 0) {
+      for (i = 0; prof.all[i] != p; i++)
+        ;
+      prof.all[i] = prof.all[--prof.n];
+      profile_free(p);
+    }
+  }
+  pthread_mutex_unlock(&prof.lock);
+}
+
+int parser_profile_enabled(void) {
+  return 1;
+}
+
+void parser_profile_label(const expr_t *e, const char *label) {
+  if (!e || !label)
+    return;
+  pthread_mutex_lock(&prof.lock);
+  precord_t *p = profile_record(e);
+  free(p->label);
+  p->label = profile_strdup(label);
+  pthread_mutex_unlock(&prof.lock);
+}
+
+void parser_profile_call(const expr_t *e, uint64_t ns) {
+  if (!e)
+    return;
+  pthread_mutex_lock(&prof.lock);
+  precord_t *p = profile_record(e);
+  p->calls++;
+  p->call_ns += ns;
+  pthread_mutex_unlock(&prof.lock);
+}
+
+static void profile_json_string(FILE *out, const char *s) {
+  fputc('"', out);
+  for (; *s; s++) {
+    if (*s == '"' || *s == '\\')
+      fprintf(out, "\\%c", *s);
+    else if ((unsigned char)*s < 0x20)
+      fprintf(out, "\\u%04x", (unsigned char)*s);
+    else
+      fputc(*s, out);
+  }
+  fputc('"', out);
+}
+
+size_t parser_profile_dump(FILE *out) {
+  size_t i, j, n = 0;
+  const char *sep;
+
+  pthread_mutex_lock(&prof.lock);
+  for (i = 0; i < prof.n; i++) {
+    const precord_t *p = prof.all[i];
+    if (p->evals == 0 && p->calls == 0)
+      continue;
+
+    fprintf(out, "{\"label\": ");
+    if (p->label)
+      profile_json_string(out, p->label);
+    else
+      fprintf(out, "null");
+    fprintf(out, ", \"evals\": %zu, \"ns\": %llu, \"calls\": %zu, \"call_ns\": %llu"
+                 ", \"symbols\": %zu, \"depth\": %zu, \"ops\": {",
+            p->evals, (unsigned long long)p->ns, p->calls,
+            (unsigned long long)p->call_ns, p->nsyms, p->depth);
+    for (j = 0, sep = ""; j < opCount; j++) {
+      if (p->ops[j]) {
+        fprintf(out, "%s\"%s\": %zu", sep, op_names[j], p->ops[j] * p->evals);
+        sep = ", ";
+      }
+    }
+    fprintf(out, "}, \"funcs\": {");
+    for (j = 0, sep = ""; j < p->nfuncs; j++) {
+      /* function symbols are named with their parenthesis */
+      fprintf(out, "%s\"%.*s\": %zu", sep, (int)strcspn(p->funcs[j].name, "("),
+              p->funcs[j].name, p->funcs[j].n * p->evals);
+      sep = ", ";
+    }
+    fprintf(out, "}}\n");
+    n++;
+  }
+  pthread_mutex_unlock(&prof.lock);
+  return n;
+}
+
+void parser_profile_reset(void) {
+  size_t i;
+  pthread_mutex_lock(&prof.lock);
+  for (i = 0; i < prof.n; i++)
+    profile_free(prof.all[i]);
+  free(prof.all);
+  free(prof.slots);
+  prof.all = prof.slots = NULL;
+  prof.n = prof.cap = prof.nslots = prof.used = 0;
+  pthread_mutex_unlock(&prof.lock);
+}
+
+#else /* _PROFILE_ */
+
+int parser_profile_enabled(void) {
+  return 0;
+}
+
+void parser_profile_label(const expr_t *e, const char *label) {
+  (void)e; (void)label;
+}
+
+void parser_profile_call(const expr_t *e, uint64_t ns) {
+  (void)e; (void)ns;
+}
+
+size_t parser_profile_dump(FILE *out) {
+  (void)out;
+  return 0;
+}
+
+void parser_profile_reset(void) {
+}
+
+#endif /* _PROFILE_ */
+
+/* vim: set sw=2 sts=2 : */
@@ -0,0 +1,394 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parser-priv.h"
+#include "parser/regvm.h"
+
+/* register machine instructions, the most common operators get their own
+ * opcode, any other goes through semanter_operator */
+typedef enum {
+  opAdd, opSub, opMul, opDiv, opPow, opNeg,
+  opBinary, opUnary,
+  opCall, opPoly, opPowi, opSqrt, opForm,
+} opcode_t;
+
+typedef struct {
+  opcode_t code;
+  union {
+    lexcomp_t op; /* operator for opBinary/opUnary */
+    uint32_t fn;  /* index into funcs for opCall, into forms->syms for opForm */
+    uint32_t degree; /* for opPoly */
+    int32_t exponent; /* for opPowi */
+  };
+  /* slots: x[dst] = x[a] <op> x[b]
+   * calls: x[dst] = funcs[fn](x[args[a]], ..., x[args[a+b-1]])
+   * polys: x[dst] = x[b] + x[b+1] * x[a] + ... x[b+degree] * x[a]^degree
+   * forms: x[dst] = forms->syms[fn] over [x[a], x[b]] */
+  uint32_t dst, a, b;
+} instr_t;
+
+/* the slot file is laid out as [registers | constants | variables] */
+struct regvm_t {
+  size_t ncode, nregs, nconst, nvars, nargs, nfuncs;
+  instr_t *code;
+  long double *consts;
+  char **vars;
+  uint32_t *args;
+  builtin_t *funcs;
+  expr_t *forms;  /* copy of the expression when it has forms */
+  uint32_t result;
+};
+
+/* slot file size that's kept on the stack while evaluating */
+#define REGVM_FILE_SZ 256
+/* call arguments gathered on the stack */
+#define REGVM_CALL_ARGS 16
+
+
+/* while compiling, operands are tagged references that get resolved to
+ * slots once the number of registers and constants is known */
+typedef enum { refReg, refConst, refVar } reftype_t;
+
+#define REF(t, i)     (((uint32_t)(t) << 30) | (uint32_t)(i))
+#define REF_TYPE(r)   ((reftype_t)((r) >> 30))
+#define REF_INDEX(r)  ((r) & 0x3fffffff)
+
+static void * grow(void *a, size_t *cap, size_t n, size_t sz) {
+  if (n < *cap)
+    return a;
+  *cap = *cap ? 2 * *cap : 16;
+  return xrealloc(a, *cap * sz);
+}
+
+static uint32_t add_const(regvm_t *p, size_t *cap, long double d) {
+  p->consts = (long double*)grow(p->consts, cap, p->nconst, sizeof(long double));
+  p->consts[p->nconst] = d;
+  return REF(refConst, p->nconst++);
+}
+
+static uint32_t add_var(regvm_t *p, hashtbl_t *index, size_t *cap, const char *name) {
+  /* each variable is looked up only once per evaluation */
+  size_t idx = (size_t)hashtbl_get(index, name);
+  if (idx)
+    return REF(refVar, idx - 1);
+  size_t len = strlen(name);
+  p->vars = (char**)grow(p->vars, cap, p->nvars, sizeof(char*));
+  p->vars[p->nvars] = (char*)zmalloc(len + 1);
+  memcpy(p->vars[p->nvars], name, len);
+  hashtbl_insert(index, name, (void*)(p->nvars + 1));
+  return REF(refVar, p->nvars++);
+}
+
+static uint32_t resolve(const regvm_t *p, uint32_t ref) {
+  switch (REF_TYPE(ref)) {
+    case refReg   : return REF_INDEX(ref);
+    case refConst : return p->nregs + REF_INDEX(ref);
+    case refVar   : return p->nregs + p->nconst + REF_INDEX(ref);
+  }
+  return 0;
+}
+
+static opcode_t operator_opcode(const symbol_t *s) {
+  switch (s->operator) {
+    case tokPlus       : return opAdd;
+    case tokMinus      : return opSub;
+    case tokTimes      : return opMul;
+    case tokDivide     : return opDiv;
+    case tokPower      : return opPow;
+    case tokUnaryMinus : return opNeg;
+    default:
+      return s->type == stBinOperator ? opBinary : opUnary;
+  }
+}
+
+
+regvm_t * regvm_compile(const expr_t *e) {
+  if (!e)
+    return NULL;
+
+  const symbol_t *s;
+  size_t i;
+
+  regvm_t *p = (regvm_t*)zmalloc(sizeof(regvm_t));
+  hashtbl_t *varindex = hashtbl_init(NULL, NULL);
+  size_t ccode = 0, cconst = 0, cvars = 0, cargs = 0, cfuncs = 0;
+  /* emulate the evaluation stack holding operand references, registers
+   * get allocated in stack order so a counter is enough to track them */
+  uint32_t *stack = (uint32_t*)zmalloc(sizeof(uint32_t) * (e->nsyms + 1));
+  size_t depth = 0, inuse = 0;
+  int error = 0;
+
+  for (i = 0; i < e->nsyms && !error; i++) {
+    s = &e->syms[i];
+    instr_t in;
+    uint32_t a, b = REF(refConst, 0);
+    size_t j;
+
+    switch (s->type) {
+      case stNumber:
+        stack[depth++] = add_const(p, &cconst, s->number);
+        continue;
+
+      case stVariable:
+        stack[depth++] = add_var(p, varindex, &cvars, s->variable);
+        continue;
+
+      case stBinOperator:
+      case stUniOperator:
+        if (depth < (s->type == stBinOperator ? 2u : 1u)) {
+          fprintf(stderr, "regvm error: missing operand\n");
+          error = 1;
+          continue;
+        }
+        if (s->type == stBinOperator)
+          b = stack[--depth];
+        a = stack[--depth];
+        /* fold operators on constants right away, reusing their pool entries */
+        if (REF_TYPE(a) == refConst && REF_TYPE(b) == refConst) {
+          long double d = semanter_operator(s->operator, p->consts[REF_INDEX(a)],
+              s->type == stBinOperator ? p->consts[REF_INDEX(b)] : 0.0);
+          if (s->type == stBinOperator && REF_INDEX(b) == p->nconst - 1)
+            p->nconst--;
+          if (REF_INDEX(a) == p->nconst - 1)
+            p->nconst--;
+          stack[depth++] = add_const(p, &cconst, d);
+          continue;
+        }
+        if (REF_TYPE(b) == refReg)
+          inuse--;
+        if (REF_TYPE(a) == refReg)
+          inuse--;
+        in.code = operator_opcode(s);
+        in.op = s->operator;
+        in.a = a; in.b = b;
+        break;
+
+      case stPolynomial:
+        /* coefficients are kept as a run of constants */
+        in.code = opPoly;
+        in.degree = s->poly.degree;
+        in.a = add_var(p, varindex, &cvars, s->poly.name);
+        in.b = add_const(p, &cconst, s->poly.coef[0]);
+        for (j = 1; j <= s->poly.degree; j++)
+          add_const(p, &cconst, s->poly.coef[j]);
+        break;
+
+      case stPowi:
+      case stSqrt:
+        if (depth < 1) {
+          fprintf(stderr, "regvm error: missing operand\n");
+          error = 1;
+          continue;
+        }
+        a = stack[--depth];
+        if (REF_TYPE(a) == refConst) {
+          long double *c = &p->consts[REF_INDEX(a)];
+          *c = s->type == stPowi ? semanter_powi(*c, s->exponent) : sqrtl(*c);
+          stack[depth++] = a;
+          continue;
+        }
+        if (REF_TYPE(a) == refReg)
+          inuse--;
+        in.code = s->type == stPowi ? opPowi : opSqrt;
+        in.exponent = s->exponent;
+        in.a = a; in.b = a;
+        break;
+
+      case stFunction:
+        if (depth < s->func.nargs) {
+          fprintf(stderr, "regvm error: missing function arguments\n");
+          error = 1;
+          continue;
+        }
+        p->funcs = (builtin_t*)grow(p->funcs, &cfuncs, p->nfuncs, sizeof(builtin_t));
+        if (!(p->funcs[p->nfuncs] = function_lookup(s->func.name))) {
+          fprintf(stderr, "regvm error: unknown function [%s]\n", s->func.name);
+          error = 1;
+          continue;
+        }
+        in.code = opCall;
+        in.fn = p->nfuncs++;
+        in.a = p->nargs;
+        in.b = s->func.nargs;
+        depth -= s->func.nargs;
+        for (j = 0; j < s->func.nargs; j++) {
+          p->args = (uint32_t*)grow(p->args, &cargs, p->nargs, sizeof(uint32_t));
+          p->args[p->nargs++] = stack[depth + j];
+          if (REF_TYPE(stack[depth + j]) == refReg)
+            inuse--;
+        }
+        break;
+
+      case stForm:
+        if (depth < 2) {
+          fprintf(stderr, "regvm error: missing %s( bounds\n", form_name(s->form.kind));
+          error = 1;
+          continue;
+        }
+        /* bodies are evaluated by the semanter out of a copy of e */
+        if (!p->forms)
+          p->forms = expr_copy(e);
+        b = stack[--depth];
+        a = stack[--depth];
+        if (REF_TYPE(b) == refReg)
+          inuse--;
+        if (REF_TYPE(a) == refReg)
+          inuse--;
+        in.code = opForm;
+        in.fn = i;
+        in.a = a; in.b = b;
+        break;
+
+      case stBound:
+        fprintf(stderr, "regvm error: bound variable outside of its form\n");
+        error = 1;
+        continue;
+    }
+
+    /* the result goes to the lowest free register */
+    in.dst = inuse++;
+    if (inuse > p->nregs)
+      p->nregs = inuse;
+    stack[depth++] = REF(refReg, in.dst);
+    p->code = (instr_t*)grow(p->code, &ccode, p->ncode, sizeof(instr_t));
+    p->code[p->ncode++] = in;
+  }
+
+  if (!error && depth != 1) {
+    fprintf(stderr, "regvm error: corrupt args stack\n");
+    error = 1;
+  }
+  if (error) {
+    free(stack);
+    hashtbl_destroy(varindex);
+    regvm_destroy(p);
+    return NULL;
+  }
+
+  /* resolve operand references into slots */
+  for (i = 0; i < p->ncode; i++) {
+    if (p->code[i].code != opCall) {
+      p->code[i].a = resolve(p, p->code[i].a);
+      p->code[i].b = resolve(p, p->code[i].b);
+    }
+  }
+  for (i = 0; i < p->nargs; i++)
+    p->args[i] = resolve(p, p->args[i]);
+  p->result = resolve(p, stack[0]);
+
+  free(stack);
+  hashtbl_destroy(varindex);
+  return p;
+}
+
+
+void regvm_destroy(regvm_t *p) {
+  if (!p)
+    return;
+  size_t i;
+  for (i = 0; i < p->nvars; i++)
+    free(p->vars[i]);
+  free(p->vars);
+  free(p->code);
+  free(p->consts);
+  free(p->args);
+  free(p->funcs);
+  free(p->forms);
+  free(p);
+}
+
+size_t regvm_instructions(const regvm_t *p) {
+  return p ? p->ncode : 0;
+}
+
+size_t regvm_registers(const regvm_t *p) {
+  return p ? p->nregs : 0;
+}
+
+
+int regvm_eval(const regvm_t *p, long double *r, hashtbl_t *vars) {
+  if (!p || !r) {
+    fprintf(stderr, "eval error: null program or result var\n");
+    return 1;
+  }
+  /* stash constants into whatever symtab we get */
+  if (vars && !hashtbl_get(vars, "_stashed"))
+    register_constants(vars);
+
+  size_t nslots = p->nregs + p->nconst + p->nvars, i;
+  long double file[REGVM_FILE_SZ], *x = file, *v;
+  if (nslots > REGVM_FILE_SZ)
+    x = (long double*)xmalloc(sizeof(long double) * nslots);
+
+  if (p->nconst)
+    memcpy(x + p->nregs, p->consts, sizeof(long double) * p->nconst);
+  for (i = 0; i < p->nvars; i++) {
+    if (!vars) {
+      fprintf(stderr, "eval error: no symbol table\n");
+      goto error;
+    }
+    if (!(v = (long double*)hashtbl_get(vars, p->vars[i]))) {
+      fprintf(stderr, "eval error: uninitialized variable [%s]\n", p->vars[i]);
+      goto error;
+    }
+    x[p->nregs + p->nconst + i] = *v;
+  }
+
+  const instr_t *in, *end = p->code + p->ncode;
+  for (in = p->code; in < end; in++) {
+    switch (in->code) {
+      case opAdd    : x[in->dst] = x[in->a] + x[in->b]; break;
+      case opSub    : x[in->dst] = x[in->a] - x[in->b]; break;
+      case opMul    : x[in->dst] = x[in->a] * x[in->b]; break;
+      case opDiv    : x[in->dst] = x[in->a] / x[in->b]; break;
+      case opPow    : x[in->dst] = pow(x[in->a], x[in->b]); break;
+      case opNeg    : x[in->dst] = -x[in->a]; break;
+      case opBinary :
+        x[in->dst] = semanter_operator(in->op, x[in->a], x[in->b]);
+        break;
+      case opUnary  :
+        x[in->dst] = semanter_operator(in->op, x[in->a], 0.0);
+        break;
+      case opPoly   :
+        x[in->dst] = poly_eval(x + in->b, in->degree, x[in->a]);
+        break;
+      case opPowi   : x[in->dst] = semanter_powi(x[in->a], in->exponent); break;
+      case opSqrt   : x[in->dst] = sqrtl(x[in->a]); break;
+      case opCall   : {
+        /* gather the arguments, they're scattered over the slot file */
+        long double argv[REGVM_CALL_ARGS], *a = argv;
+        if (in->b > REGVM_CALL_ARGS)
+          a = (long double*)xmalloc(sizeof(long double) * in->b);
+        for (i = 0; i < in->b; i++)
+          a[i] = x[p->args[in->a + i]];
+        x[in->dst] = p->funcs[in->fn](a, in->b);
+        if (a != argv)
+          free(a);
+        break;
+      }
+      case opForm   :
+        if (semanter_form(p->forms, &p->forms->syms[in->fn], NULL,
+                          x[in->a], x[in->b], vars, x + in->dst))
+          goto error;
+        break;
+    }
+  }
+
+  *r = x[p->result];
+  if (x != file)
+    free(x);
+  return 0;
+
+error:
+  if (x != file)
+    free(x);
+  return 1;
+}
+
+/* vim: set sw=2 sts=2 : */
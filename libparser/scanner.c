@@ -141,4 +141,12 @@ void * scanner_apply(scanner_t *s, acceptfn f) {
   return r;
 }
 
+const char * scanner_slice(scanner_t *s, size_t *len) {
+  if (!s)
+    return NULL;
+  if (len)
+    *len = s->length;
+  return s->buffer + s->start;
+}
+
 /* vim: set sw=2 sts=2 : */
@@ -2,6 +2,7 @@
 #define _GNU_SOURCE
 #endif
 #include <math.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -9,25 +10,22 @@
 #include "parser-priv.h"
 
 
-symbol_t * symbol_number(long double d) {
-  symbol_t *s = (symbol_t*)zmalloc(sizeof(symbol_t));
+symbol_t * symbol_number(arena_t *a, long double d) {
+  symbol_t *s = (symbol_t*)arena_alloc(a, sizeof(symbol_t));
   s->type = stNumber;
   s->number = d;
   return s;
 }
 
-symbol_t * symbol_variable(char *varname) {
-  int len = strlen(varname);
-  symbol_t *s = (symbol_t*)zmalloc(sizeof(symbol_t) + len + 1);
+symbol_t * symbol_variable(arena_t *a, const char *varname) {
+  symbol_t *s = (symbol_t*)arena_alloc(a, sizeof(symbol_t));
   s->type = stVariable;
-  s->variable = (char*)s + sizeof(symbol_t);
-  memmove(s->variable, varname, len);
-  s->variable[len] = '\0';
+  s->variable = arena_strndup(a, varname, strlen(varname));
   return s;
 }
 
-symbol_t * symbol_operator(lexcomp_t lc) {
-  symbol_t *s = (symbol_t*)zmalloc(sizeof(symbol_t));
+symbol_t * symbol_operator(arena_t *a, lexcomp_t lc) {
+  symbol_t *s = (symbol_t*)arena_alloc(a, sizeof(symbol_t));
   if (lc == tokUnaryMinus || lc == tokBitNot || lc == tokNot)
     s->type = stUniOperator;
   else
@@ -36,24 +34,146 @@ symbol_t * symbol_operator(lexcomp_t lc) {
   return s;
 }
 
-symbol_t * symbol_function(char *funcname, size_t nargs) {
-  int len = strlen(funcname);
-  symbol_t *s = (symbol_t*)zmalloc(sizeof(symbol_t) + len + 1);
+symbol_t * symbol_function(arena_t *a, const char *funcname, size_t nargs) {
+  symbol_t *s = (symbol_t*)arena_alloc(a, sizeof(symbol_t));
   s->type = stFunction;
-  s->func.name = (char*)s + sizeof(symbol_t);
-  memmove(s->func.name, funcname, len);
-  s->func.name[len] = '\0';
+  s->func.name = arena_strndup(a, funcname, strlen(funcname));
   s->func.nargs = nargs;
   return s;
 }
 
-void symbol_destroy(symbol_t *s) {
-  if (!s)
-    return;
-  free(s);
+symbol_t * symbol_polynomial(arena_t *a, const char *varname,
+                             const long double *coef, size_t degree) {
+  symbol_t *s = (symbol_t*)arena_alloc(a, sizeof(symbol_t));
+  s->type = stPolynomial;
+  s->poly.coef = (long double*)arena_alloc(a, sizeof(long double) * (degree + 1));
+  memmove(s->poly.coef, coef, sizeof(long double) * (degree + 1));
+  s->poly.degree = degree;
+  s->poly.name = arena_strndup(a, varname, strlen(varname));
+  return s;
+}
+
+symbol_t * symbol_powi(arena_t *a, long exponent) {
+  symbol_t *s = (symbol_t*)arena_alloc(a, sizeof(symbol_t));
+  s->type = stPowi;
+  s->exponent = exponent;
+  return s;
+}
+
+symbol_t * symbol_sqrt(arena_t *a) {
+  symbol_t *s = (symbol_t*)arena_alloc(a, sizeof(symbol_t));
+  s->type = stSqrt;
+  return s;
+}
+
+symbol_t * symbol_bound(arena_t *a, size_t level) {
+  symbol_t *s = (symbol_t*)arena_alloc(a, sizeof(symbol_t));
+  s->type = stBound;
+  s->bound = level;
+  return s;
+}
+
+
+/* name a symbol points to, if any */
+static const char * symbol_name(const symbol_t *s) {
+  switch (s->type) {
+    case stVariable   : return s->variable;
+    case stFunction   : return s->func.name;
+    case stPolynomial : return s->poly.name;
+    default:
+      return NULL;
+  }
+}
+
+/* number of symbols in syms and the bodies of their forms */
+static size_t expr_count(symbol_t **syms, size_t n) {
+  size_t i, total = n;
+  for (i = 0; i < n; i++)
+    if (syms[i]->type == stForm)
+      total += expr_count(syms[i]->form.syms, syms[i]->form.nbody);
+  return total;
 }
 
-static long double semanter_operator(lexcomp_t lc, long double lhs, long double rhs) {
+expr_t * expr_build(symbol_t **syms, size_t n) {
+  size_t i, ncoef = 0, nname = 0, total = expr_count(syms, n), next = n;
+  symbol_t **all = (symbol_t**)xmalloc(sizeof(symbol_t*) * (total + 1));
+  const char *name;
+
+  /* bodies go after the evaluated symbols, nested ones after those */
+  memcpy(all, syms, sizeof(symbol_t*) * n);
+  for (i = 0; i < next; i++) {
+    if (all[i]->type == stForm) {
+      memcpy(all + next, all[i]->form.syms, sizeof(symbol_t*) * all[i]->form.nbody);
+      all[i]->form.body = next;
+      next += all[i]->form.nbody;
+    }
+  }
+
+  for (i = 0; i < total; i++) {
+    if ((name = symbol_name(all[i])))
+      nname += strlen(name) + 1;
+    if (all[i]->type == stPolynomial)
+      ncoef += all[i]->poly.degree + 1;
+  }
+
+  size_t size = offsetof(expr_t, syms) + sizeof(symbol_t) * total +
+                sizeof(long double) * ncoef + nname;
+  expr_t *e = (expr_t*)xmalloc(size);
+  long double *coef = (long double*)(e->syms + total);
+  char *names = (char*)(coef + ncoef);
+  e->size = size;
+  e->nsyms = n;
+  e->nbody = total - n;
+
+  for (i = 0; i < total; i++) {
+    symbol_t *s = &e->syms[i];
+    *s = *all[i];
+    if (s->type == stForm) {
+      s->form.var = NULL;
+      s->form.syms = NULL;
+    }
+    if (s->type == stPolynomial) {
+      memcpy(coef, s->poly.coef, sizeof(long double) * (s->poly.degree + 1));
+      s->poly.coef = coef;
+      coef += s->poly.degree + 1;
+    }
+    if ((name = symbol_name(s))) {
+      size_t len = strlen(name) + 1;
+      memcpy(names, name, len);
+      switch (s->type) {
+        case stVariable   : s->variable = names; break;
+        case stFunction   : s->func.name = names; break;
+        case stPolynomial : s->poly.name = names; break;
+        default: break;
+      }
+      names += len;
+    }
+  }
+  free(all);
+  return e;
+}
+
+expr_t * expr_copy(const expr_t *e) {
+  expr_t *c = (expr_t*)xmalloc(e->size);
+  size_t i;
+  memcpy(c, e, e->size);
+
+  /* everything symbols point to lives in the block, rebase it */
+#define REBASE(p) ((p) = (void*)((char*)c + ((const char*)(p) - (const char*)e)))
+  for (i = 0; i < e->nsyms + e->nbody; i++) {
+    symbol_t *s = &c->syms[i];
+    switch (s->type) {
+      case stVariable   : REBASE(s->variable); break;
+      case stFunction   : REBASE(s->func.name); break;
+      case stPolynomial : REBASE(s->poly.name); REBASE(s->poly.coef); break;
+      default: break;
+    }
+  }
+#undef REBASE
+  return c;
+}
+
+long double semanter_operator(lexcomp_t lc, long double lhs, long double rhs) {
   switch (lc) {
     /* mathops */
     case tokPlus       : return lhs+rhs;
@@ -87,116 +207,172 @@ static long double semanter_operator(lexcomp_t lc, long double lhs, long double
     case tokNumber     : case tokId      : case tokFunction :
     case tokAsign      : case tokText    :
     case tokTrue       : case tokFalse   :
-    case tokStackEmpty : case tokNoMatch :
+    case tokStackEmpty : case tokNoMatch : case tokEol      :
     case tokOMango     : case tokEMango  : case tokCMango   :
       break;
   }
   return 0;
 }
 
+long double semanter_powi(long double x, long n) {
+  unsigned long k = n < 0 ? -(unsigned long)n : (unsigned long)n;
+  long double r = 1.0;
+  for (; k; k >>= 1, x *= x)
+    if (k & 1)
+      r *= x;
+  return n < 0 ? 1.0 / r : r;
+}
+
+
+/* operand stack size kept on the C stack while evaluating, an expression
+ * can't need more slots than it has symbols */
+#define EVAL_STACK_SZ 256
 
 #define unlikely(x) __builtin_expect(!!(x), 0)
-int parser_eval(const expr_t *e, long double *r, hashtbl_t *vars) {
+static int semanter_eval(const expr_t *e, long double *r, hashtbl_t *vars) {
   if (!e || !r) {
     fprintf(stderr, "eval error: null expression or result var\n");
     return 1;
   }
 
-  /* load known functions */
-  static hashtbl_t *functions = NULL;
-  if (unlikely(functions == NULL)) {
-    functions = hashtbl_init(NULL, NULL);
-    register_functions(functions);
-  }
   /* stash constants into whatever symtab we get */
   if (unlikely(vars && !hashtbl_get(vars, "_stashed"))) {
     register_constants(vars);
   }
 
-  const list_t *l = (const list_t*)e;
-  const list_node_t *n = list_last(l);
-  list_t *args = list_init(free, NULL);
-  const symbol_t *s;
+  long double buf[EVAL_STACK_SZ], *args = buf, *v;
+  size_t i, n = 0;
+  builtin_t f;
 
-  while (n && (s = (const symbol_t*)list_data(n))) {
-    long double *d = NULL, *v = NULL;
-    long double (*f)(list_t*, size_t);
+  if (e->nsyms > EVAL_STACK_SZ)
+    args = (long double*)xmalloc(sizeof(long double) * e->nsyms);
+
+  for (i = 0; i < e->nsyms; i++) {
+    const symbol_t *s = &e->syms[i];
 
     switch (s->type) {
       case stNumber:
-        d = (long double*)zmalloc(sizeof(long double));
-        *d = s->number;
-        list_push(args, d);
+        args[n++] = s->number;
         break;
 
       case stVariable:
         if (!vars) {
           fprintf(stderr, "eval error: no symbol table\n");
-          list_destroy(args);
-          return 1;
+          goto error;
         }
         if (!(v = (long double*)hashtbl_get(vars, s->variable))) {
           fprintf(stderr, "eval error: uninitialized variable [%s]\n", s->variable);
-          list_destroy(args);
-          return 1;
+          goto error;
+        }
+        args[n++] = *v;
+        break;
+
+      case stPolynomial:
+        if (!vars) {
+          fprintf(stderr, "eval error: no symbol table\n");
+          goto error;
         }
-        d = (long double*)zmalloc(sizeof(long double));
-        *d = *v;
-        list_push(args, d);
+        if (!(v = (long double*)hashtbl_get(vars, s->poly.name))) {
+          fprintf(stderr, "eval error: uninitialized variable [%s]\n", s->poly.name);
+          goto error;
+        }
+        args[n++] = poly_eval(s->poly.coef, s->poly.degree, *v);
         break;
 
       case stBinOperator:
-        /* rhs operand */
-        if (!(v = (long double*)list_pop(args))) {
-          fprintf(stderr, "eval error: missing rhs operand\n");
-          list_destroy(args);
-          return 1;
+        if (n < 2) {
+          fprintf(stderr, "eval error: missing %s operand\n", n ? "lhs" : "rhs");
+          goto error;
         }
-        /*FALLTHROUGH*/
+        n--;
+        args[n-1] = semanter_operator(s->operator, args[n-1], args[n]);
+        break;
+
       case stUniOperator:
-        /* lhs operand, don't pop it... use it to store the result too */
-        if (!(d = (long double*)list_peek_head(args))) {
+        if (n < 1) {
           fprintf(stderr, "eval error: missing lhs operand\n");
-          list_destroy(args);
-          return 1;
+          goto error;
+        }
+        args[n-1] = semanter_operator(s->operator, args[n-1], 0.0);
+        break;
+
+      case stPowi:
+      case stSqrt:
+        if (n < 1) {
+          fprintf(stderr, "eval error: missing operand\n");
+          goto error;
         }
-        *d = semanter_operator(s->operator, *d, s->type == stBinOperator ? *v : 0.0);
-        free(v);
+        args[n-1] = s->type == stPowi ? semanter_powi(args[n-1], s->exponent)
+                                      : sqrtl(args[n-1]);
         break;
 
       case stFunction:
-        if (!(f = (long double(*)(list_t*, size_t))hashtbl_get(functions, s->func.name))) {
+        if (!(f = function_lookup(s->func.name))) {
           fprintf(stderr, "eval error: unknown function [%s]\n", s->func.name);
-          list_destroy(args);
-          return 1;
+          goto error;
+        }
+        if (n < s->func.nargs) {
+          fprintf(stderr, "eval error: corrupt args stack\n");
+          goto error;
+        }
+        /* arguments are the top nargs slots, the result replaces them */
+        n -= s->func.nargs;
+        args[n] = f(args + n, s->func.nargs);
+        n++;
+        break;
+
+      case stForm:
+        if (n < 2) {
+          fprintf(stderr, "eval error: missing %s( bounds\n", form_name(s->form.kind));
+          goto error;
         }
-        d = (long double*)zmalloc(sizeof(long double));
-        *d = f(args, s->func.nargs);
-        list_push(args, d);
+        n--;
+        if (semanter_form(e, s, NULL, args[n-1], args[n], vars, &args[n-1]))
+          goto error;
         break;
+
+      case stBound:
+        fprintf(stderr, "eval error: bound variable outside of its form\n");
+        goto error;
     }
-    n = list_prev(n);
   }
 
-  if (list_size(args) != 1) {
+  if (n != 1) {
     fprintf(stderr, "eval error: corrupt args stack\n");
-    list_destroy(args);
-    return 1;
+    goto error;
   }
 
-  long double *d = (long double*)list_peek_head(args);
-  *r = *d;
-  list_destroy(args);
+  *r = args[0];
+  if (args != buf)
+    free(args);
   return 0;
+
+error:
+  if (args != buf)
+    free(args);
+  return 1;
+}
+
+int parser_eval(const expr_t *e, long double *r, hashtbl_t *vars) {
+#ifdef _PROFILE_
+  uint64_t t0 = parser_profile_clock();
+  int ret = semanter_eval(e, r, vars);
+  if (ret == 0)
+    profile_eval(e, parser_profile_clock() - t0);
+  return ret;
+#else
+  return semanter_eval(e, r, vars);
+#endif
 }
 
 
 /* parse symbols out of tokens */
-int semanter_reduce(list_t *stack, list_t *partial) {
+int semanter_reduce(pstack_t *stack, pstack_t *partial) {
+  arena_t *a = partial->arena;
   size_t funcparams = 0;
   token_t *op;
 
-  while ((op = (token_t*)list_pop(stack))) {
+  while ((op = (token_t*)pstack_pop(stack))) {
     switch (op->lexcomp) {
       /* binary operators */
       case tokPlus   : case tokMinus  : case tokTimes  :
@@ -206,27 +382,28 @@ int semanter_reduce(list_t *stack, list_t *partial) {
       case tokAnd    : case tokOr     : case tokNot    :
       case tokEq     : case tokNe     : case tokGt     :
       case tokLt     : case tokGe     : case tokLe     :
-        list_push(partial, symbol_operator(op->lexcomp));
+        pstack_push(partial, symbol_operator(a, op->lexcomp));
         break;
 
       case tokNumber:
-        list_push(partial, symbol_number(strtold(op->lexem, NULL)));
+        pstack_push(partial, symbol_number(a, strtold(op->lexem, NULL)));
         break;
       case tokTrue:
-        list_push(partial, symbol_number(1.0));
+        pstack_push(partial, symbol_number(a, 1.0));
         break;
       case tokFalse:
-        list_push(partial, symbol_number(0.0));
+        pstack_push(partial, symbol_number(a, 0.0));
         break;
       case tokId:
-        list_push(partial, symbol_variable(op->lexem));
+        pstack_push(partial, symbol_variable(a, op->lexem));
         break;
       case tokFunction:
-        list_push(partial, symbol_function(op->lexem, funcparams));
+        pstack_push(partial, symbol_function(a, op->lexem, funcparams));
         break;
 
       /* ignore these, no semantic value */
       case tokComma   : case tokStackEmpty : case tokNoMatch :
+      case tokEol     :
       case tokCMango  : case tokOParen     : case tokCParen  :
       case tokAsign   : case tokText:
         break;
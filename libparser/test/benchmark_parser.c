@@ -0,0 +1,183 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "parser/scanner.h"
+#include "parser/lexer.h"
+#include "parser/parser.h"
+#include "baas/hashtbl.h"
+#include "generate.h"
+
+/* throughput of the three stages (lexing, compiling, evaluating) over
+ * corpora of small, medium and huge expressions. Each stage is timed over
+ * a number of rounds and the spread between rounds is reported */
+
+/* expressions from test_parser */
+static const char *small[] = {
+  "23+45", "-23", "23.41 * 34e+2", "98 / 0.4235", "23489 % 234.23",
+  "3**3", "144**0.5", "64 >> 2", "7 | 5", "~0", "not 0", "0 or 3",
+  "3.1415 == 31415e-4", "3.1415 <= 31415e2", "3*(75.34-4)", "2**(3-1)",
+  "max(10, 20, 12, 15)", "sum(1, 2, 3, 4, 5, 6)", "avg(3.4, 4e-2, 3.5, a)",
+  "abs(-34)", "cos(a)**2 + sin(a)**2", "sin(phi)/cos(phi) - tan(phi)",
+  "1 + tan(a)**2 - 1/cos(a)**2", "atan2(a, phi) == atan(a/phi)",
+  "acos(cos(phi)) - phi", "log(exp(3))", "gamma(16)", "3 + 4 * 5",
+  "(3 * 5)**2", "32 >> 3 & 6", "4 | 5 ^ 3 & 2", "false and false or true",
+  "max(3, 4) - -min(-3, 4)",
+  "5.23e+3**4**-2 + avg(34>>2, phi < pi, max(phi, pi, 3.2))",
+  "e**tan(x)/(1+x**2)*sin((1+log(x)**2)**0.5)",
+  "3.5*x**4 - 30.3*x**3 + 7.2*x**2 - 3.4*x + 32.0",
+};
+
+#define NSMALL   (sizeof(small)/sizeof(small[0]))
+#define NMEDIUM  64
+#define MEDIUM   48     /* leaves per medium expression */
+#define HUGE     20000  /* leaves of the huge expression */
+
+typedef struct {
+  const char *name;
+  const char **exprs;
+  size_t n;
+  size_t repeat;        /* passes over exprs per round */
+} corpus_t;
+
+static unsigned long long now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static const char *gen_vars[] = { "x", "a", NULL };
+static const char *gen_funcs[] = {
+  "sin(", "cos(", "abs(", "exp(", "max(x, ", NULL
+};
+/* keep powers rare, they overflow quickly */
+static const generate_t gen = { gen_vars, gen_funcs, 32 };
+
+static int dblcmp(const void *a, const void *b) {
+  double x = *(const double*)a, y = *(const double*)b;
+  return x < y ? -1 : x > y;
+}
+
+/* nearest rank percentile of sorted samples */
+static double percentile(const double *v, size_t n, double p) {
+  size_t i = (size_t)(p / 100.0 * n + 0.5);
+  return v[i ? (i > n ? n : i) - 1 : 0];
+}
+
+/* ns per unit of each round, lower is better */
+static void report(const char *stage, const char *corpus, const char *unit,
+                   double *ns, size_t rounds) {
+  qsort(ns, rounds, sizeof(double), dblcmp);
+  double p50 = percentile(ns, rounds, 50);
+  printf("%-8s %-8s %12.0f %-7s %10.1f %10.1f %10.1f %10.1f\n",
+         stage, corpus, 1e9 / p50, unit, ns[0], p50,
+         percentile(ns, rounds, 90), percentile(ns, rounds, 99));
+}
+
+static size_t lex(const char *expr) {
+  scanner_t *s = scanner_init(expr);
+  token_t *t;
+  size_t n = 0;
+  while ((t = lexer_nextitem(s))->lexcomp != tokStackEmpty && t->lexcomp != tokNoMatch) {
+    token_destroy(t);
+    n++;
+  }
+  token_destroy(t);
+  scanner_destroy(s);
+  return n;
+}
+
+static void benchmark(const corpus_t *c, size_t rounds, hashtbl_t *vars) {
+  double *ns = (double*)zmalloc(sizeof(double) * rounds);
+  expr_t **e = (expr_t**)zmalloc(sizeof(expr_t*) * c->n);
+  long double r, sink = 0.0;
+  size_t i, j, k, tokens = 0;
+  unsigned long long t0;
+
+  for (k = 0; k < rounds; k++) {
+    t0 = now();
+    for (j = 0, tokens = 0; j < c->repeat; j++)
+      for (i = 0; i < c->n; i++)
+        tokens += lex(c->exprs[i]);
+    ns[k] = (double)(now() - t0) / tokens;
+  }
+  report("lex", c->name, "tok/s", ns, rounds);
+
+  for (k = 0; k < rounds; k++) {
+    t0 = now();
+    for (j = 0; j < c->repeat; j++)
+      for (i = 0; i < c->n; i++) {
+        if (j || k)
+          parser_destroy_expr(e[i]);
+        e[i] = parser_compile_str(c->exprs[i]);
+      }
+    ns[k] = (double)(now() - t0) / (c->n * c->repeat);
+  }
+  report("compile", c->name, "expr/s", ns, rounds);
+
+  /* evaluations are cheaper than compiles, do more of them */
+  for (k = 0; k < rounds; k++) {
+    t0 = now();
+    for (j = 0; j < 10 * c->repeat; j++)
+      for (i = 0; i < c->n; i++) {
+        parser_eval(e[i], &r, vars);
+        sink += r;
+      }
+    ns[k] = (double)(now() - t0) / (10 * c->n * c->repeat);
+  }
+  report("eval", c->name, "eval/s", ns, rounds);
+
+  for (i = 0; i < c->n; i++)
+    parser_destroy_expr(e[i]);
+  free(e);
+  free(ns);
+  /* keep the evaluations from being optimized away */
+  if (sink == 0.12345)
+    fprintf(stderr, "%Lg\n", sink);
+}
+
+int main(int argc, char **argv) {
+  size_t i, rounds = argc > 1 ? strtoul(argv[1], NULL, 10) : 25;
+  hashtbl_t *vars = hashtbl_init(free, NULL);
+  long double *a = (long double*)zmalloc(sizeof(long double)),
+              *x = (long double*)zmalloc(sizeof(long double));
+  *a = 46; *x = 0.3;
+  hashtbl_insert(vars, "a", a);
+  hashtbl_insert(vars, "x", x);
+  if (rounds == 0)
+    rounds = 1;
+
+  srandom(1);
+  const char *medium[NMEDIUM], *huge[1];
+  char *bufs[NMEDIUM + 1];
+  for (i = 0; i <= NMEDIUM; i++) {
+    size_t leaves = i < NMEDIUM ? MEDIUM : HUGE;
+    bufs[i] = (char*)zmalloc(leaves * 32);
+    generate(bufs[i], leaves, &gen);
+  }
+  for (i = 0; i < NMEDIUM; i++)
+    medium[i] = bufs[i];
+  huge[0] = bufs[NMEDIUM];
+
+  const corpus_t corpora[] = {
+    { "small", small, NSMALL, 100 },
+    { "medium", medium, NMEDIUM, 20 },
+    { "huge", huge, 1, 2 },
+  };
+
+  printf("%-8s %-8s %12s %-7s %10s %10s %10s %10s\n", "# stage", "corpus",
+         "median", "", "min ns", "p50 ns", "p90 ns", "p99 ns");
+  for (i = 0; i < sizeof(corpora)/sizeof(corpora[0]); i++)
+    benchmark(&corpora[i], rounds, vars);
+
+  for (i = 0; i <= NMEDIUM; i++)
+    free(bufs[i]);
+  hashtbl_destroy(vars);
+  return 0;
+}
+
+/* vim: set sw=2 sts=2 : */
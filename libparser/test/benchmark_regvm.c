@@ -0,0 +1,116 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "parser/parser.h"
+#include "parser/regvm.h"
+#include "baas/hashtbl.h"
+#include "generate.h"
+
+/* expressions from test_parser */
+static const char *corpus[] = {
+  "23+45", "-23", "23.41 * 34e+2", "98 / 0.4235", "23489 % 234.23",
+  "3**3", "144**0.5", "64 >> 2", "7 | 5", "~0", "not 0", "0 or 3",
+  "3.1415 == 31415e-4", "3.1415 <= 31415e2", "3*(75.34-4)", "2**(3-1)",
+  "max(10, 20, 12, 15)", "sum(1, 2, 3, 4, 5, 6)", "avg(3.4, 4e-2, 3.5, a)",
+  "abs(-34)", "cos(a)**2 + sin(a)**2", "sin(phi)/cos(phi) - tan(phi)",
+  "1 + tan(a)**2 - 1/cos(a)**2", "atan2(a, phi) == atan(a/phi)",
+  "acos(cos(phi)) - phi", "log(exp(3))", "gamma(16)", "3 + 4 * 5",
+  "(3 * 5)**2", "32 >> 3 & 6", "4 | 5 ^ 3 & 2", "false and false or true",
+  "max(3, 4) - -min(-3, 4)",
+  "5.23e+3**4**-2 + avg(34>>2, phi < pi, max(phi, pi, 3.2))",
+  "e**tan(x)/(1+x**2)*sin((1+log(x)**2)**0.5)",
+  "3.5*x**4 - 30.3*x**3 + 7.2*x**2 - 3.4*x + 32.0",
+};
+
+/* return the number of usec between t0 and t1 */
+long utime_diff(const struct timeval *t0, const struct timeval *t1) {
+  return (t1->tv_sec - t0->tv_sec) * 1e6 + (t1->tv_usec - t0->tv_usec);
+}
+
+static const char *gen_vars[] = { "x", "a", NULL };
+static const char *gen_funcs[] = { "sin(", "cos(", "abs(", "exp(", NULL };
+static const generate_t gen = { gen_vars, gen_funcs, 0 };
+
+/* time iter evaluations of each expression on both backends */
+void benchmark(const char *name, const char **exprs, size_t n,
+               size_t iter, hashtbl_t *vars) {
+  struct timeval t0, t1;
+  long double r = 0.0, sink = 0.0;
+  long tstack, tregvm;
+  size_t i, j, regs = 0, code = 0;
+
+  expr_t **e = (expr_t**)zmalloc(sizeof(expr_t*) * n);
+  regvm_t **p = (regvm_t**)zmalloc(sizeof(regvm_t*) * n);
+  for (i = 0; i < n; i++) {
+    e[i] = parser_compile_str(exprs[i]);
+    p[i] = regvm_compile(e[i]);
+    regs += regvm_registers(p[i]);
+    code += regvm_instructions(p[i]);
+  }
+
+  gettimeofday(&t0, NULL);
+  for (j = 0; j < iter; j++)
+    for (i = 0; i < n; i++) {
+      parser_eval(e[i], &r, vars);
+      sink += r;
+    }
+  gettimeofday(&t1, NULL);
+  tstack = utime_diff(&t0, &t1);
+
+  gettimeofday(&t0, NULL);
+  for (j = 0; j < iter; j++)
+    for (i = 0; i < n; i++) {
+      regvm_eval(p[i], &r, vars);
+      sink -= r;
+    }
+  gettimeofday(&t1, NULL);
+  tregvm = utime_diff(&t0, &t1);
+
+  fprintf(stderr, "%s: %zu exprs, avg %.1f instructions %.1f registers\n"
+          "  stack: %ld usec (%.0f evals/sec)\n"
+          "  regvm: %ld usec (%.0f evals/sec) speedup %.2fx (%Lg)\n",
+          name, n, (double)code / n, (double)regs / n,
+          tstack, 1e6 * n * iter / tstack,
+          tregvm, 1e6 * n * iter / tregvm, (double)tstack / tregvm, sink);
+
+  for (i = 0; i < n; i++) {
+    regvm_destroy(p[i]);
+    parser_destroy_expr(e[i]);
+  }
+  free(p);
+  free(e);
+}
+
+int main(void) {
+  hashtbl_t *vars = hashtbl_init(free, NULL);
+  long double *a = (long double*)zmalloc(sizeof(long double)),
+              *x = (long double*)zmalloc(sizeof(long double));
+  *a = 46; *x = 3.0;
+  hashtbl_insert(vars, "a", a);
+  hashtbl_insert(vars, "x", x);
+
+  const size_t ncorpus = sizeof(corpus)/sizeof(corpus[0]);
+  benchmark("corpus", corpus, ncorpus, 20000, vars);
+
+  const size_t sizes[] = { 100, 1000, 10000 };
+  size_t i;
+  srandom(1);
+  for (i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++) {
+    char name[64], *buf = (char*)zmalloc(sizes[i] * 32);
+    const char *exprs[1] = { buf };
+    generate(buf, sizes[i], &gen);
+    snprintf(name, sizeof(name), "generated-%zu", sizes[i]);
+    benchmark(name, exprs, 1, 2000000 / sizes[i], vars);
+    free(buf);
+  }
+
+  hashtbl_destroy(vars);
+  return 0;
+}
+
+/* vim: set sw=2 sts=2 : */
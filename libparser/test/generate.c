@@ -0,0 +1,40 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "generate.h"
+
+static size_t count(const char *const *v) {
+  size_t n = 0;
+  while (v[n])
+    n++;
+  return n;
+}
+
+size_t generate(char *buf, size_t n, const generate_t *g) {
+  static const char *ops[] = { "+", "-", "*", "/" };
+  size_t nvars = count(g->vars), nfuncs = count(g->funcs);
+  if (n <= 1) {
+    /* a variable or a constant, evenly */
+    size_t v = random() % (nvars + 1);
+    if (v < nvars)
+      return sprintf(buf, "%s", g->vars[v]);
+    return sprintf(buf, "%ld.%ld", random() % 100, random() % 100);
+  }
+  size_t l = 0, k = 1 + random() % (n - 1);
+  if (nfuncs && random() % 8 == 0) {
+    l += sprintf(buf + l, "%s", g->funcs[random() % nfuncs]);
+    l += generate(buf + l, n - 1, g);
+    return l + sprintf(buf + l, ")");
+  }
+  l += sprintf(buf + l, "(");
+  l += generate(buf + l, k, g);
+  if (g->pow && random() % g->pow == 0)
+    l += sprintf(buf + l, "**");
+  else
+    l += sprintf(buf + l, "%s", ops[random() % 4]);
+  l += generate(buf + l, n - k, g);
+  return l + sprintf(buf + l, ")");
+}
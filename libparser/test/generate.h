@@ -0,0 +1,17 @@
+#ifndef _GENERATE_H_
+#define _GENERATE_H_
+
+#include <stddef.h>
+
+/* what random expressions are made of */
+typedef struct {
+  const char *const *vars;   /* leaf variables, NULL terminated */
+  const char *const *funcs;  /* "name(" prefixes, NULL terminated */
+  unsigned pow;              /* one in pow operators is **, 0: never */
+} generate_t;
+
+/* write a random expression tree with about n leaves into buf, which
+ * needs room for about 32 chars per leaf. returns the length written */
+size_t generate(char *buf, size_t n, const generate_t *g);
+
+#endif /* _GENERATE_H_ */
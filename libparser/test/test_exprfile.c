@@ -0,0 +1,141 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "parser/parser.h"
+#include "parser/exprfile.h"
+#include "parser/regvm.h"
+#include "baas/hashtbl.h"
+
+static const char *exprs[] = {
+  "23+45", "-23", "23.41 * 34e+2", "64 >> 2.2", "not 0", "2**(3-1)",
+  "max(10, 20, 12, 15)", "avg(3.4, 4e-2, 3.5, a)", "abs(-34)",
+  "cos(a)**2 + sin(a)**2", "atan2(a, phi) == atan(a/phi)", "gamma(16)",
+  "5.23e+3**4**-2 + avg(34>>2, phi < pi, max(phi, pi, 3.2))",
+  "e**tan(a)/(1+a**2)*sin((1+log(a)**2)**0.5)",
+  "3.5*a**4 - 30.3*a**3 + 7.2*a**2 - 3.4*a + 32.0", "(a/40 - 1)**9 + a**2",
+  "sin(a)**3 / 8 + (a + 1)**0.5 - cos(a)**-2", "a / 4 + b * a",
+  "series(i, 1, 10, a / i + product(j, 1, i, 0.9 + b/j))",
+};
+#define NEXPRS (sizeof(exprs)/sizeof(exprs[0]))
+
+static hashtbl_t *vars = NULL;
+
+/* write the corpus to file, return the compiled expressions */
+expr_t ** write_corpus(const char *file) {
+  expr_t **e = (expr_t**)zmalloc(sizeof(expr_t*) * NEXPRS);
+  size_t i;
+  for (i = 0; i < NEXPRS; i++)
+    assert((e[i] = parser_compile_str(exprs[i])));
+  assert(exprfile_write(file, e, NEXPRS) == 0);
+  return e;
+}
+
+void check_roundtrip(const char *file) {
+  expr_t **e = write_corpus(file);
+  exprfile_t *f = exprfile_open(file);
+  size_t i;
+
+  assert(f != NULL);
+  assert(exprfile_count(f) == NEXPRS);
+  assert(exprfile_get(f, NEXPRS) == NULL);
+
+  for (i = 0; i < NEXPRS; i++) {
+    const expr_t *g = exprfile_get(f, i);
+    long double r = 0.0, s = 0.0, t = 0.0;
+    assert(parser_eval(e[i], &r, vars) == 0);
+    assert(parser_eval(g, &s, vars) == 0);
+    assert(r == s || (isnan(r) && isnan(s)));
+
+    /* loaded expressions feed the other backends too */
+    regvm_t *p = regvm_compile(g);
+    assert(p && regvm_eval(p, &t, vars) == 0);
+    assert(s == t || (isnan(s) && isnan(t)));
+    regvm_destroy(p);
+    parser_destroy_expr(e[i]);
+  }
+  free(e);
+
+  /* polynomial detection works on the relocated symbols */
+  const char *var = NULL;
+  long double *coef = NULL;
+  assert(parser_polynomial(exprfile_get(f, 14), &var, &coef) == 4);
+  assert(!strcmp(var, "a") && coef[4] == 3.5L);
+  free(coef);
+
+  exprfile_close(f);
+}
+
+/* flip a byte at off and check the file is rejected */
+void check_corrupt(const char *file, long off) {
+  FILE *fp = fopen(file, "r+b");
+  int c;
+  assert(fp);
+  fseek(fp, off, off < 0 ? SEEK_END : SEEK_SET);
+  c = fgetc(fp);
+  fseek(fp, -1, SEEK_CUR);
+  fputc(c ^ 0x5a, fp);
+  fclose(fp);
+  assert(exprfile_open(file) == NULL);
+}
+
+void check_invalid(const char *file) {
+  size_t i;
+  expr_t **e;
+
+  assert(exprfile_open("/nonexistent/exprs") == NULL);
+
+  /* header, index and block corruption */
+  const long offs[] = { 0, 8, 16, 40, 48, 200, -1 };
+  for (i = 0; i < sizeof(offs)/sizeof(offs[0]); i++) {
+    e = write_corpus(file);
+    check_corrupt(file, offs[i]);
+    size_t j;
+    for (j = 0; j < NEXPRS; j++)
+      parser_destroy_expr(e[j]);
+    free(e);
+  }
+
+  /* truncated */
+  e = write_corpus(file);
+  assert(truncate(file, 100) == 0);
+  assert(exprfile_open(file) == NULL);
+  for (i = 0; i < NEXPRS; i++)
+    parser_destroy_expr(e[i]);
+  free(e);
+
+  /* an empty set is fine */
+  assert(exprfile_write(file, NULL, 0) == 0);
+  exprfile_t *f = exprfile_open(file);
+  assert(f && exprfile_count(f) == 0);
+  exprfile_close(f);
+}
+
+int main(void) {
+  char file[] = "/tmp/test_exprfileXXXXXX";
+  int fd = mkstemp(file);
+  assert(fd >= 0);
+  close(fd);
+
+  vars = hashtbl_init(free, NULL);
+  long double *a = (long double*)zmalloc(sizeof(long double)),
+              *b = (long double*)zmalloc(sizeof(long double));
+  *a = 46; *b = 0.25;
+  hashtbl_insert(vars, "a", a);
+  hashtbl_insert(vars, "b", b);
+
+  check_roundtrip(file);
+  check_invalid(file);
+
+  unlink(file);
+  hashtbl_destroy(vars);
+  return 0;
+}
+
+/* vim: set sw=2 sts=2 : */
@@ -0,0 +1,110 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "parser/parser.h"
+#include "parser/exprset.h"
+#include "baas/hashtbl.h"
+#include "generate.h"
+
+static hashtbl_t *vars = NULL;
+
+static const char *gen_vars[] = { "a", NULL };
+static const char *gen_funcs[] = { "sin(", NULL };
+static const generate_t gen = { gen_vars, gen_funcs, 5 };
+
+/* compiled results must match the serial compiler exactly */
+void check_same(const exprset_t *set, const char *const *strs, size_t n) {
+  size_t i;
+  assert(exprset_size(set) == n);
+  for (i = 0; i < n; i++) {
+    expr_t *e = parser_compile_str(strs[i]);
+    const expr_t *g = exprset_get(set, i);
+    long double r = 0.0, s = 0.0;
+    assert((e == NULL) == (g == NULL));
+    assert((e == NULL) == (exprset_error(set, i) != 0));
+    if (e) {
+      assert(parser_eval(e, &r, vars) == 0);
+      assert(parser_eval(g, &s, vars) == 0);
+      assert(r == s || (isnan(r) && isnan(s)));
+    }
+    parser_destroy_expr(e);
+  }
+}
+
+void check_array(void) {
+  const size_t n = 5000;
+  char **strs = (char**)zmalloc(sizeof(char*) * n);
+  size_t i, nthreads;
+
+  srandom(7);
+  for (i = 0; i < n; i++) {
+    strs[i] = (char*)zmalloc(2048);
+    generate(strs[i], 1 + random() % 40, &gen);
+  }
+  /* sprinkle some syntax errors */
+  strcpy(strs[10], "3 + (4 * 2");
+  strcpy(strs[4000], "max(1, 2))");
+
+  for (nthreads = 1; nthreads <= 8; nthreads *= 2) {
+    exprset_t *set = exprset_compile((const char *const *)strs, n, nthreads);
+    assert(exprset_failed(set) == 2);
+    assert(exprset_error(set, 10) == 4);
+    assert(exprset_error(set, 4000) == 6);
+    check_same(set, (const char *const *)strs, n);
+    exprset_destroy(set);
+  }
+
+  for (i = 0; i < n; i++)
+    free(strs[i]);
+  free(strs);
+
+  /* empty sets and auto thread count */
+  exprset_t *set = exprset_compile(NULL, 0, 0);
+  assert(exprset_size(set) == 0 && exprset_get(set, 0) == NULL);
+  exprset_destroy(set);
+}
+
+void check_file(void) {
+  const char *strs[] = {
+    "3.5*a**4 - 30.3*a**3 + 7.2*a**2", "cos(a)**2 + sin(a)**2",
+    "1 +* 2 (", "max(3, 4) - -min(-3, 4)", "a / 4",
+  };
+  const size_t n = sizeof(strs)/sizeof(strs[0]);
+  char file[] = "/tmp/test_exprsetXXXXXX";
+  int fd = mkstemp(file);
+  size_t i;
+  assert(fd >= 0);
+  FILE *fp = fdopen(fd, "w");
+  for (i = 0; i < n; i++)
+    fprintf(fp, "%s%s", strs[i], i + 1 < n ? "\n" : "");
+  fclose(fp);
+
+  exprset_t *set = exprset_compile_file(file, 3);
+  assert(exprset_failed(set) == 1 && exprset_get(set, 2) == NULL);
+  check_same(set, strs, n);
+  exprset_destroy(set);
+
+  unlink(file);
+  assert(exprset_compile_file(file, 3) == NULL);
+}
+
+int main(void) {
+  vars = hashtbl_init(free, NULL);
+  long double *a = (long double*)zmalloc(sizeof(long double));
+  *a = 1.25;
+  hashtbl_insert(vars, "a", a);
+
+  check_array();
+  check_file();
+  hashtbl_destroy(vars);
+  return 0;
+}
+
+/* vim: set sw=2 sts=2 : */
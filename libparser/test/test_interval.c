@@ -0,0 +1,145 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+
+#include "parser/parser.h"
+#include "parser/interval.h"
+#include "baas/hashtbl.h"
+
+static hashtbl_t *vars = NULL, *ivars = NULL;
+
+static void set(const char *name, long double v) {
+  long double *d = (long double*)hashtbl_get(vars, name);
+  if (!d) {
+    d = (long double*)zmalloc(sizeof(long double));
+    hashtbl_insert(vars, name, d);
+  }
+  *d = v;
+}
+
+static void iset(const char *name, long double lo, long double hi) {
+  ival_t *d = (ival_t*)hashtbl_get(ivars, name);
+  if (!d) {
+    d = (ival_t*)zmalloc(sizeof(ival_t));
+    hashtbl_insert(ivars, name, d);
+  }
+  d->lo = lo;
+  d->hi = hi;
+}
+
+static ival_t enclose(const char *expr) {
+  expr_t *e = parser_compile_str(expr);
+  ival_t r;
+  assert(e && parser_eval_interval(e, &r, ivars) == 0);
+  parser_destroy_expr(e);
+  return r;
+}
+
+/* sample the box [lo, hi] for x and y and check every point lands in
+ * the enclosure */
+void check_enclosure(const char *expr, long double lo, long double hi) {
+  expr_t *e = parser_compile_str(expr);
+  ival_t r;
+  size_t i, j;
+  assert(e);
+  iset("x", lo, hi);
+  iset("y", lo / 2, hi / 2);
+  assert(parser_eval_interval(e, &r, ivars) == 0);
+  assert(r.lo <= r.hi);
+
+  for (i = 0; i <= 20; i++)
+    for (j = 0; j <= 20; j++) {
+      long double v = 0.0;
+      set("x", i == 20 ? hi : lo + (hi - lo) * i / 20);
+      set("y", j == 20 ? hi / 2 : (lo + (hi - lo) * j / 20) / 2);
+      if (parser_eval(e, &v, vars) != 0 || isnan(v))
+        continue;
+      if (v < r.lo || v > r.hi) {
+        fprintf(stderr, "[%s] %Lg outside [%Lg, %Lg]\n", expr, v, r.lo, r.hi);
+        abort();
+      }
+    }
+  parser_destroy_expr(e);
+}
+
+void check_operators(void) {
+  const char *exprs[] = {
+    "x + y", "x - y", "x * y", "x / (y + 10)", "-x", "x % 3", "x**2",
+    "x**3 - 2*x", "x**-2", "abs(x)**0.5", "(x*x)**y", "2**x", "x**0.5",
+    "x < y", "x >= 0", "x == y", "x != 1", "not x", "x and y", "x or 0",
+    "3.5*x**4 - 30.3*x**3 + 7.2*x**2 - 3.4*x + 32.0", "(x/40 - 1)**9 + x**2",
+    "max(x, y, 1)", "min(x, -y)", "sum(x, y, 3)", "avg(x, y)", "abs(x - 1)",
+    "sin(x)", "cos(x*y)", "tan(x/4)", "asin(x/10)", "acos(y/10)", "atan(x)",
+    "atan2(y, x)", "atan2(x + 20, y)", "log(x*x + 1)", "exp(x)", "gamma(x*x + 0.1)",
+    "round(x * 3.3)", "sin(x)**2 + cos(x)**2", "e**tan(x/8)/(1+x**2)*sin(pi*x)",
+    "64 >> 2", "7 | 5",
+  };
+  const long double boxes[][2] = {
+    { -10, 10 }, { 0.5, 0.75 }, { -3, -2.5 }, { 1, 1 }, { 0, 7 }, { -0.1, 0.2 },
+  };
+  size_t i, j;
+  for (i = 0; i < sizeof(exprs)/sizeof(exprs[0]); i++)
+    for (j = 0; j < sizeof(boxes)/sizeof(boxes[0]); j++)
+      check_enclosure(exprs[i], boxes[j][0], boxes[j][1]);
+}
+
+void check_tight(void) {
+  ival_t r;
+
+  iset("x", -2, 3);
+  r = enclose("x**2");
+  assert(r.lo == 0.0 && r.hi >= 9.0 && r.hi < 9.0 + 1e-12);
+  r = enclose("1/x");
+  assert(isinf(r.lo) && isinf(r.hi));
+  r = enclose("x > 4");
+  assert(r.lo == 0.0 && r.hi == 0.0);
+  r = enclose("(x > -2) and (x < 3.5)");
+  assert(r.lo == 0.0 && r.hi == 1.0);
+  r = enclose("(x >= -2) and (x < 3.5)");
+  assert(r.lo == 1.0 && r.hi == 1.0);
+
+  /* extrema inside the interval */
+  iset("x", 0, 3.2);
+  r = enclose("sin(x)");
+  assert(r.hi == 1.0 && r.lo < 0.0 && r.lo > -0.06);
+  r = enclose("cos(x)");
+  assert(r.lo == -1.0 && r.hi == 1.0);
+  iset("x", 1, 2);
+  r = enclose("tan(x)");
+  assert(isinf(r.lo) && isinf(r.hi));
+  r = enclose("gamma(x)");
+  assert(r.lo > 0.885 && r.lo < 0.8857 && r.hi >= 1.0);
+
+  /* % runs in double, the enclosure must hold that result */
+  const long double xs[] = { 1e10 + 0.3, 0.7, -123456.789 };
+  size_t i;
+  for (i = 0; i < sizeof(xs)/sizeof(xs[0]); i++) {
+    check_enclosure("x % 0.1", xs[i], xs[i]);
+    check_enclosure("x % y", xs[i], xs[i]);
+  }
+  check_enclosure("log(x)", 0, 2);
+
+  /* no root of x**2 - 2 in [2, 3] */
+  iset("x", 2, 3);
+  r = enclose("x**2 - 2");
+  assert(r.lo > 0.0);
+  /* constants are available without a symbol table */
+  r = enclose("pi");
+  assert(r.lo <= 3.14159265358979311600L && r.hi >= 3.14159265358979311600L && r.hi - r.lo < 1e-15);
+}
+
+int main(void) {
+  vars = hashtbl_init(free, NULL);
+  ivars = hashtbl_init(free, NULL);
+
+  check_operators();
+  check_tight();
+
+  hashtbl_destroy(ivars);
+  hashtbl_destroy(vars);
+  return 0;
+}
+
+/* vim: set sw=2 sts=2 : */
@@ -110,10 +110,109 @@ void test_unkown(void) {
 }
 
 
+void test_eol(void) {
+  const lexcomp_t expected[] = {
+    tokId, tokAsign, tokNumber, tokEol, tokEol,
+    tokFunction, tokId, tokCParen, tokEol, tokStackEmpty
+  };
+  scanner_t *s = scanner_init("a = 3 \r\n\n  sin(a)\n");
+  lexer_t *l = lexer_init(s);
+  token_t *t;
+  size_t i;
+
+  lexer_set_eol(l, 1);
+  for (i = 0; i < sizeof(expected)/sizeof(expected[0]); i++) {
+    t = lexer_advance(l);
+    assert(t->lexcomp == expected[i]);
+  }
+  lexer_destroy(l);
+  scanner_destroy(s);
+
+  /* newlines are whitespace by default */
+  s = scanner_init("a\n=\n3\n");
+  l = lexer_init(s);
+  assert(lexer_advance(l)->lexcomp == tokId);
+  assert(lexer_advance(l)->lexcomp == tokAsign);
+  assert(lexer_advance(l)->lexcomp == tokNumber);
+  assert(lexer_advance(l)->lexcomp == tokStackEmpty);
+  lexer_destroy(l);
+  scanner_destroy(s);
+}
+
+/* tokens are recycled once consumed, runs longer than the ring grow it */
+void test_ring(void) {
+  char *text = (char*)zmalloc(64 * 1024);
+  size_t i, n = 0, line;
+  token_t *seen[64], *t;
+  size_t nseen = 0;
+
+  for (line = 0; line < 2000; line++)
+    n += sprintf(text + n, "x%zu = 12 + y\n", line % 7);
+  /* a statement longer than the ring */
+  for (i = 0; i < 100; i++)
+    n += sprintf(text + n, "%zu + ", i);
+  sprintf(text + n, "0\n");
+
+  scanner_t *s = scanner_init(text);
+  lexer_t *l = lexer_init(s);
+  lexer_set_eol(l, 1);
+  for (line = 0; line < 2000; line++) {
+    while ((t = lexer_advance(l))->lexcomp != tokEol) {
+      for (i = 0; i < nseen && seen[i] != t; i++)
+        ;
+      if (i == nseen) {
+        assert(nseen < 64);
+        seen[nseen++] = t;
+      }
+    }
+    /* the statement is still there to rewind */
+    while (lexer_backup(l))
+      ;
+    assert(lexer_advance(l)->lexcomp == tokId);
+    assert(lexer_advance(l)->lexcomp == tokAsign);
+    assert(!strcmp(lexer_advance(l)->lexem, "12"));
+    lexer_consume(l);
+    /* the rest of the statement was scanned already */
+    assert(lexer_advance(l)->lexcomp == tokPlus);
+    assert(lexer_advance(l)->lexcomp == tokId);
+    assert(lexer_advance(l)->lexcomp == tokEol);
+    lexer_consume(l);
+  }
+  /* the tokens of every line come from the same few slots */
+  assert(nseen <= 16);
+
+  for (i = 0; i < 100; i++) {
+    assert(lexer_advance(l)->lexcomp == tokNumber);
+    assert(lexer_advance(l)->lexcomp == tokPlus);
+  }
+  /* a peeked token outlives the consumption of the ones before it */
+  assert(lexer_peek(l)->lexcomp == tokNumber);
+  while (lexer_backup(l))
+    ;
+  assert(!strcmp(lexer_advance(l)->lexem, "0"));
+  for (i = 1; i < 100; i++) {
+    assert(lexer_advance(l)->lexcomp == tokPlus);
+    t = lexer_advance(l);
+    assert(t->lexcomp == tokNumber && (size_t)atoi(t->lexem) == i);
+  }
+  assert(lexer_advance(l)->lexcomp == tokPlus);
+  lexer_consume(l);
+  t = lexer_advance(l);
+  assert(t->lexcomp == tokNumber && !strcmp(t->lexem, "0"));
+  assert(lexer_advance(l)->lexcomp == tokEol);
+  assert(lexer_advance(l)->lexcomp == tokStackEmpty);
+
+  lexer_destroy(l);
+  scanner_destroy(s);
+  free(text);
+}
+
 int main(void) {
   test_numbers();
   test_lexer();
   test_unkown();
+  test_eol();
+  test_ring();
   return 0;
 }
 
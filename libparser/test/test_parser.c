@@ -6,6 +6,7 @@
 
 #include "parser/parser.h"
 #include "baas/hashtbl.h"
+#include "parser-priv.h"
 
 static hashtbl_t *vars = NULL;
 
@@ -74,6 +75,8 @@ void check_operators(void) {
   ASSERT_EQ(evaluate("2**(3-1)"), 4);
 }
 
+static expr_t * compile_with(frontend_t front, const char *expr, int *err);
+
 void check_functions(void) {
   long double *a = (long double*)zmalloc(sizeof(long double));
   *a = 46;
@@ -98,6 +101,17 @@ void check_functions(void) {
   ASSERT_EPS(evaluate("log(234 * 4234) - log(234) - log(4234)"), 0.0, 1.0e-5);
 
   ASSERT_EQ(roundl(evaluate("gamma(16)")), 1307674368000);
+
+  /* calls are checked against the arity of the function */
+  int err;
+  const char *bad[] = { "sin(1, 2)", "atan2(1)", "atan2(1, 2, 3)", "sin()",
+                        "max()", "random(1)", "2 * series(i, 1, 3, cos(i, i))" };
+  size_t i;
+  for (i = 0; i < sizeof(bad)/sizeof(bad[0]); i++) {
+    assert(compile_with(parser_climb, bad[i], &err) == NULL && err == 10);
+    assert(compile_with(parser_shift_reduce, bad[i], &err) == NULL && err == 10);
+  }
+  ASSERT_EQ(evaluate("sum()"), 0);
 }
 
 void check_precedence(void) {
@@ -137,6 +151,150 @@ void check_longer(void) {
   ASSERT_EPS(evaluate("e**tan(x)/(1+x**2)*sin((1+log(x)**2)**0.5)"), 514696792827.659, 1.0e-3);
 }
 
+void check_polynomials(void) {
+  long double *x = (long double*)hashtbl_get(vars, "x"), *c = NULL;
+  const char *var = NULL;
+  *x = 1.75;
+  ASSERT_EQ(evaluate("3.5*x**4 - 30.3*x**3 + 7.2*x**2 - 3.4*x + 32.0"),
+            3.5*powl(1.75, 4) - 30.3*powl(1.75, 3) + 7.2*1.75*1.75 - 3.4*1.75 + 32.0);
+  ASSERT_EQ(evaluate("(x + 1)**12 / 4096"), powl(2.75, 12) / 4096);
+  ASSERT_EQ(evaluate("-(x - 2)*(x + 2) + x**2"), 4);
+  ASSERT_EQ(evaluate("sin(x**2 + 1) - sin(1 + x*x)"), 0.0);
+  ASSERT_EQ(evaluate("max(x**3, 2*x**2 - 1, 5)"), 1.75 * 1.75 * 1.75);
+  ASSERT_EQ(evaluate("x**2 + a*x**2"), (1 + *(long double*)hashtbl_get(vars, "a")) * 1.75 * 1.75);
+  ASSERT_EQ(evaluate("x**2.5 + x**3"), powl(1.75, 2.5) + powl(1.75, 3));
+  ASSERT_EQ(evaluate("2**3 * x**2"), 8 * 1.75 * 1.75);
+
+  expr_t *e = parser_compile_str("3.5*x**4 - 30.3*x**3 + 7.2*x**2 - 3.4*x + 32.0");
+  assert(parser_polynomial(e, &var, &c) == 4);
+  assert(strcmp(var, "x") == 0);
+  ASSERT_EQ(c[0], 32.0); ASSERT_EQ(c[1], -3.4); ASSERT_EQ(c[2], 7.2);
+  ASSERT_EQ(c[3], -30.3); ASSERT_EQ(c[4], 3.5);
+  free(c);
+  parser_destroy_expr(e);
+
+  e = parser_compile_str("(2*x - 1)**2");
+  assert(parser_polynomial(e, &var, &c) == 2);
+  ASSERT_EQ(c[0], 1); ASSERT_EQ(c[1], -4); ASSERT_EQ(c[2], 4);
+  free(c);
+  parser_destroy_expr(e);
+
+  /* lone powers are compiled to powi */
+  e = parser_compile_str("x**5 - 1");
+  assert(parser_polynomial(e, &var, &c) == 5);
+  ASSERT_EQ(c[0], -1); ASSERT_EQ(c[4], 0); ASSERT_EQ(c[5], 1);
+  free(c);
+  parser_destroy_expr(e);
+
+  e = parser_compile_str("x**2 + a*x");
+  assert(parser_polynomial(e, &var, &c) == -1);
+  parser_destroy_expr(e);
+  e = parser_compile_str("x**-1");
+  assert(parser_polynomial(e, &var, &c) == -1);
+  parser_destroy_expr(e);
+}
+
+void check_strength(void) {
+  long double *x = (long double*)hashtbl_get(vars, "x");
+  *x = 2.5;
+  ASSERT_EQ(evaluate("sin(x)**2 + cos(x)**2"), 1.0);
+  ASSERT_EQ(evaluate("sin(x)**3"), powl(sinl(2.5), 3));
+  ASSERT_EQ(evaluate("sin(x)**-2"), 1.0 / powl(sinl(2.5), 2));
+  ASSERT_EQ(evaluate("log(x)**1"), logl(2.5));
+  ASSERT_EQ(evaluate("exp(x)**0"), 1.0);
+  ASSERT_EQ(evaluate("(x + 6.75)**0.5"), 3.041381265149110);
+  ASSERT_EQ(evaluate("sin(x)**0.25"), powl(sinl(2.5), 0.25));
+  ASSERT_EQ(evaluate("sin(x) / 8"), sinl(2.5) / 8);
+  ASSERT_EQ(evaluate("sin(x) / 3"), sinl(2.5) / 3);
+  ASSERT_EQ(evaluate("sin(x) / -0.25"), -4 * sinl(2.5));
+  assert(isinf(evaluate("sin(x) / 0")));
+  ASSERT_EQ(evaluate("-2**2 * 3 - sin(x)"), 12 - sinl(2.5));
+  ASSERT_EQ(evaluate("2**x"), powl(2, 2.5));
+}
+
+void check_forms(void) {
+  long double *x = (long double*)hashtbl_get(vars, "x");
+  *x = 2.0;
+  ASSERT_EQ(evaluate("series(i, 1, 100, i)"), 5050);
+  ASSERT_EQ(evaluate("series(i, 1, 10, x**i)"), 2046);
+  ASSERT_EQ(evaluate("series(i, 1, 0, i)"), 0);
+  ASSERT_EQ(evaluate("product(i, 1, 10, i)"), 3628800);
+  ASSERT_EQ(evaluate("product(i, 1, 0, i)"), 1);
+  ASSERT_EQ(evaluate("series(k, 0, 25, 1/gamma(k+1))"), expl(1));
+  ASSERT_EQ(evaluate("integral(t, 0, pi, sin(t))"), 2.0);
+  ASSERT_EQ(evaluate("integral(t, 0, x, t**3 - t)"), 2.0);
+  ASSERT_EQ(evaluate("integral(t, 1, 0, t)"), -0.5);
+  /* nesting, inner forms see the outer variables */
+  ASSERT_EQ(evaluate("series(i, 1, 4, series(j, 1, i, i*j))"), 65);
+  ASSERT_EQ(evaluate("integral(t, 0, 1, integral(s, 0, t, s*t))"), 0.125);
+  ASSERT_EQ(evaluate("2*series(i, 1, 3, i) + x"), 14);
+  /* calls with more arguments than fit on the stack */
+  ASSERT_EQ(evaluate("series(i, 1, 3, max(1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, i + 16))"), 54);
+  /* the bound variable shadows x only within the body */
+  ASSERT_EQ(evaluate("series(x, 1, 3, x) + x"), 8);
+  /* compensated summation keeps the tail of the series */
+  ASSERT_EPS(evaluate("series(n, 1, 200000, 1/n**2) + 1/200000 - pi**2/6"), 0.0, 1.0e-10);
+
+  assert(parser_compile_str("series(i, 1, 3)") == NULL);
+  assert(parser_compile_str("series(2, 1, 3, 4)") == NULL);
+  assert(parser_compile_str("product(i + 1, 1, 3, i)") == NULL);
+}
+
+static expr_t * compile_with(frontend_t front, const char *expr, int *err) {
+  arena_t *a = arena_init(0);
+  scanner_t *s = scanner_init(expr);
+  lexer_t *l = lexer_init(s);
+  lexer_set_arena(l, a);
+  expr_t *e = parser_compile_with(front, l, a, err);
+  lexer_destroy(l);
+  scanner_destroy(s);
+  arena_destroy(a);
+  return e;
+}
+
+/* precedence climbing must compile what the shift-reduce loop does */
+void check_frontends(void) {
+  static const char *valid[] = {
+    "-23", "3*(75.34-4)", "2**(3-1)", "-3**2", "-2**2*3", "2**-1", "2**3**2",
+    "3 * 7 % 3", "32 >> 3 & 6", "4 << (7 ^ 5)", "4 | 5 ^ 3 & 2", "~~5 & 3",
+    "false and false or true", "not 1 or 1", "1 < 2 < 3", "1 + 2 == 3",
+    "x*-x - -x", "max(3, 4) - -min(-3, 4)", "random() < 1", "(((x)))",
+    "5.23e+3**4**-2 + avg(34>>2, phi < pi, max(phi, pi, 3.2))",
+    "e**tan(x)/(1+x**2)*sin((1+log(x)**2)**0.5)",
+    "series(i, 1, 4, series(j, 1, i, i*j)) - product(k, 1, 3, -k)",
+  };
+  static const char *invalid[] = {
+    "1 + 2 >> 1", "x > -2 and x < 3.5", "1 & -2", "2 3", "(1)(2)", "x sin(x)",
+    "(1 + 2", "max(1, 2", "1, 2", "(1, 2)", "1 + 2)", "-1 and 1", "3 $ 4",
+  };
+  size_t i;
+  int e1, e2;
+
+  for (i = 0; i < sizeof(valid)/sizeof(valid[0]); i++) {
+    expr_t *a = compile_with(parser_shift_reduce, valid[i], &e1),
+           *b = compile_with(parser_climb, valid[i], &e2);
+    assert(a && b && e1 == 0 && e2 == 0);
+    assert(a->nsyms == b->nsyms && a->nbody == b->nbody);
+    long double ra, rb;
+    if (strncmp(valid[i], "random", 6)) {
+      assert(parser_eval(a, &ra, vars) == 0 && parser_eval(b, &rb, vars) == 0);
+      assert(ra == rb || (isnan(ra) && isnan(rb)));
+    }
+    parser_destroy_expr(a);
+    parser_destroy_expr(b);
+  }
+  for (i = 0; i < sizeof(invalid)/sizeof(invalid[0]); i++) {
+    assert(compile_with(parser_shift_reduce, invalid[i], &e1) == NULL);
+    assert(compile_with(parser_climb, invalid[i], &e2) == NULL);
+    assert(e1 == e2);
+  }
+
+  /* operands the shift-reduce loop let through to the evaluation */
+  assert(compile_with(parser_climb, "1 +", &e2) == NULL && e2 == 7);
+  assert(compile_with(parser_climb, "()", &e2) == NULL && e2 == 7);
+  assert(compile_with(parser_climb, "max(1, )", &e2) == NULL && e2 == 7);
+}
+
 int main(void) {
   vars = hashtbl_init(free, NULL);
   /*fprintf(stderr, "%.15Lg\n", evaluate(argv[1]));*/
@@ -144,6 +302,10 @@ int main(void) {
   check_functions();
   check_precedence();
   check_longer();
+  check_polynomials();
+  check_strength();
+  check_forms();
+  check_frontends();
   hashtbl_destroy(vars);
   return 0;
 }
@@ -0,0 +1,93 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "parser/parser.h"
+#include "parser/profile.h"
+#include "baas/hashtbl.h"
+
+static hashtbl_t *vars = NULL;
+
+/* dump the profile into a string (user must free) */
+static char * dump(size_t *n) {
+  char *buf = NULL;
+  size_t len = 0;
+  FILE *out = open_memstream(&buf, &len);
+  *n = parser_profile_dump(out);
+  fclose(out);
+  return buf;
+}
+
+void check_disabled(void) {
+  size_t n;
+  long double r;
+  expr_t *e = parser_compile_str("1 + 2");
+  assert(parser_eval(e, &r, vars) == 0);
+  char *s = dump(&n);
+  assert(n == 0 && strlen(s) == 0);
+  free(s);
+  parser_destroy_expr(e);
+}
+
+void check_counts(void) {
+  size_t i, n;
+  long double r;
+  expr_t *e = parser_compile_str("sin(a) * sin(a) + max(a, 2, 3) - 1/a"),
+         *unused = parser_compile_str("a + 1");
+
+  for (i = 0; i < 10; i++)
+    assert(parser_eval(e, &r, vars) == 0);
+  parser_profile_call(e, 5);
+  parser_destroy_expr(unused);
+
+  char *s = dump(&n);
+  assert(n == 1);
+  assert(strstr(s, "\"label\": \"sin(a) * sin(a) + max(a, 2, 3) - 1/a\""));
+  assert(strstr(s, "\"evals\": 10,"));
+  assert(strstr(s, "\"calls\": 1, \"call_ns\": 5,"));
+  assert(strstr(s, "\"depth\": 4,"));
+  assert(strstr(s, "\"*\": 10"));
+  assert(strstr(s, "\"/\": 10"));
+  assert(strstr(s, "\"sin\": 20"));
+  assert(strstr(s, "\"max\": 10"));
+  free(s);
+
+  /* profiles outlive their expressions until reset */
+  parser_destroy_expr(e);
+  s = dump(&n);
+  assert(n == 1);
+  free(s);
+  parser_profile_reset();
+  s = dump(&n);
+  assert(n == 0);
+  free(s);
+
+  /* failed evaluations aren't accounted */
+  e = parser_compile_str("undefined + 1");
+  assert(parser_eval(e, &r, vars) != 0);
+  s = dump(&n);
+  assert(n == 0);
+  free(s);
+  parser_destroy_expr(e);
+}
+
+int main(void) {
+  vars = hashtbl_init(free, NULL);
+  long double *a = (long double*)zmalloc(sizeof(long double));
+  *a = 3;
+  hashtbl_insert(vars, "a", a);
+
+  if (parser_profile_enabled())
+    check_counts();
+  else
+    check_disabled();
+
+  hashtbl_destroy(vars);
+  return 0;
+}
+
+/* vim: set sw=2 sts=2 : */
@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+
+#include "parser/parser.h"
+#include "parser/regvm.h"
+#include "baas/hashtbl.h"
+
+static hashtbl_t *vars = NULL;
+
+/* evaluate expr with both backends and check they agree */
+long double evaluate(const char *expr) {
+  expr_t *e = NULL;
+  regvm_t *p = NULL;
+  if (!(e = parser_compile_str(expr)) || !(p = regvm_compile(e)))
+    abort();
+
+  long double r = 0.0, s = 0.0;
+  if (parser_eval(e, &r, vars) != 0 || regvm_eval(p, &s, vars) != 0) {
+    fprintf(stderr, "[%s] failed\n", expr);
+    abort();
+  }
+  assert((isnan(r) && isnan(s)) || r == s);
+  regvm_destroy(p);
+  parser_destroy_expr(e);
+  return s;
+}
+
+#define EPSILON 1.0e-10
+#define ASSERT_EQ(x, y) assert(fabsl((x)-(y)) < EPSILON)
+
+void check_expressions(void) {
+  const char *exprs[] = {
+    "23+45", "23-45", "-23", "--5343", "23.41 * 34e+2", "98 / 0.4235",
+    "23489 % 234.23", "144**0.5", "64 >> 2.2", "7 | 8", "10 ^ 11", "~1",
+    "not 0", "0 or 3", "3.1415 <= 31415e2", "-(75.34)", "2**(3-1)",
+    "max(10, 20, 12, 15)", "avg(3.4, 4e-2, 3.5, a)", "abs(-34)",
+    "cos(a)**2 + sin(a)**2", "atan2(a, phi) == atan(a/phi)",
+    "log(234 * 4234) - log(234) - log(4234)", "gamma(16)",
+    "3*5**2", "-3**2", "32 >> 3 & 6", "4 | (5 ^ 3) & 2",
+    "false and (false or true)", "1 < 2 < 3", "max(3, 4) - -min(-3, 4)",
+    "5.23e+3**4**-2 + avg(34>>2, phi < pi, max(phi, pi, 3.2))",
+    "e**tan(a)/(1+a**2)*sin((1+log(a)**2)**0.5)",
+    "a*a + 2*a*a - a*(a - a*(a + 1))",
+    "sin(a)**3 / 8 + (a + 1)**0.5 - cos(a)**-2 + 2**3**0.5",
+    "3.5*a**4 - 30.3*a**3 + 7.2*a**2 - 3.4*a + 32.0", "(a/40 - 1)**9 + a**2",
+    "series(i, 1, a, i**2) / a", "a + integral(t, 0, a/10, t * sin(t))",
+    "product(i, 1, 5, series(j, 1, i, j/i))",
+  };
+  size_t i;
+  for (i = 0; i < sizeof(exprs)/sizeof(exprs[0]); i++)
+    evaluate(exprs[i]);
+
+  ASSERT_EQ(evaluate("a"), 46);
+  ASSERT_EQ(evaluate("3 * (75.34 - a)"), 88.02);
+  ASSERT_EQ(evaluate("sum(1, 2, a, 4, 5, 6)"), 64);
+}
+
+void check_program(void) {
+  expr_t *e = parser_compile_str("(2 + 3) * 4 - -1");
+  regvm_t *p = regvm_compile(e);
+  long double r = 0.0;
+  /* constant operators are folded away */
+  assert(regvm_instructions(p) == 0);
+  assert(regvm_eval(p, &r, vars) == 0);
+  ASSERT_EQ(r, 21);
+  regvm_destroy(p);
+  parser_destroy_expr(e);
+
+  /* operands are addressed in place, only results take registers */
+  e = parser_compile_str("a*a + a*(a - 1)");
+  p = regvm_compile(e);
+  assert(regvm_instructions(p) == 4);
+  assert(regvm_registers(p) == 2);
+  regvm_destroy(p);
+  parser_destroy_expr(e);
+
+  /* unknown functions are rejected up front */
+  e = parser_compile_str("nosuchfunc(3)");
+  assert(regvm_compile(e) == NULL);
+  parser_destroy_expr(e);
+
+  /* undefined variables fail on evaluation */
+  e = parser_compile_str("undefined + 1");
+  p = regvm_compile(e);
+  assert(regvm_eval(p, &r, vars) != 0);
+  regvm_destroy(p);
+  parser_destroy_expr(e);
+}
+
+void check_large(void) {
+  /* deep nesting needs more registers than the stack kept slot file */
+  char buf[8192];
+  size_t i, n = 0;
+  for (i = 0; i < 300; i++)
+    n += sprintf(buf + n, "a*%zu+(", i);
+  n += sprintf(buf + n, "1");
+  for (i = 0; i < 300; i++)
+    buf[n++] = ')';
+  buf[n] = '\0';
+  ASSERT_EQ(evaluate(buf), 46 * (299 * 300 / 2) + 1);
+}
+
+int main(void) {
+  vars = hashtbl_init(free, NULL);
+  long double *a = (long double*)zmalloc(sizeof(long double));
+  *a = 46;
+  hashtbl_insert(vars, "a", a);
+
+  check_expressions();
+  check_program();
+  check_large();
+  hashtbl_destroy(vars);
+  return 0;
+}
+
+/* vim: set sw=2 sts=2 : */
@@ -12,6 +12,7 @@
 #include "parser/scanner.h"
 #include "parser/lexer.h"
 #include "parser/parser.h"
+#include "parser/regvm.h"
 
 /* Parse a mini-language:
  *   vars        : print defined variables
@@ -81,19 +82,141 @@ int parse_statement(lexer_t *l) {
 }
 
 
+/* batch mode keeps at most this many compiled statements around */
+#define BATCH_CACHE_SZ 4096
+
+typedef struct {
+  char *var;      /* variable assigned by the statement or NULL */
+  regvm_t *prog;
+} statement_t;
+
+void statement_destroy(statement_t *st) {
+  if (!st)
+    return;
+  free(st->var);
+  regvm_destroy(st->prog);
+  free(st);
+}
+
+/* scan the tokens of the next statement and store their text in key,
+ * return the token ending the statement */
+token_t * statement_key(lexer_t *l, char **key, size_t *sz) {
+  size_t n = 0;
+  token_t *t;
+  while ((t = lexer_advance(l))->lexcomp != tokEol && t->lexcomp != tokStackEmpty) {
+    size_t len = strlen(t->lexem);
+    if (n + len + 2 > *sz) {
+      *sz = 2 * (n + len + 2);
+      *key = (char*)xrealloc(*key, *sz);
+    }
+    memcpy(*key + n, t->lexem, len);
+    n += len;
+    (*key)[n++] = ' ';
+  }
+  (*key)[n] = '\0';
+  return t;
+}
+
+/* compile the statement the lexer is positioned before */
+statement_t * statement_compile(lexer_t *l) {
+  statement_t *st = (statement_t*)zmalloc(sizeof(statement_t));
+  token_t *start = lexer_advance(l);
+
+  if (start->lexcomp == tokId && lexer_peek(l)->lexcomp == tokAsign) {
+    st->var = strdup(start->lexem);
+    lexer_advance(l);
+  } else
+    lexer_backup(l);
+
+  expr_t *e = parser_compile(l);
+  st->prog = regvm_compile(e);
+  parser_destroy_expr(e);
+  if (!st->prog) {
+    statement_destroy(st);
+    return NULL;
+  }
+  return st;
+}
+
+/* evaluate one statement per line of file ("-" for stdin), statements
+ * are compiled once and looked up by their token text afterwards */
+int parse_batch(const char *file) {
+  scanner_t *s = scanner_init_file(file);
+  if (!s) {
+    fprintf(stderr, "error: unable to open %s\n", file);
+    return 1;
+  }
+  lexer_t *l = lexer_init(s);
+  hashtbl_t *cache = hashtbl_init((free_func_t)statement_destroy, NULL);
+  size_t sz = 256, cached = 0;
+  char *key = (char*)zmalloc(sz);
+  int err = 0, eof = 0;
+  token_t *end;
+
+  lexer_set_eol(l, 1);
+  do {
+    end = statement_key(l, &key, &sz);
+    eof = end->lexcomp == tokStackEmpty;
+
+    if (!strcmp(key, "vars "))
+      print_variables(vars);
+
+    else if (strcmp(key, "")) {
+      statement_t *st = (statement_t*)hashtbl_get(cache, key);
+      if (!st) {
+        /* rewind to the start of the statement */
+        while (lexer_backup(l));
+        if ((st = statement_compile(l))) {
+          if (cached++ == BATCH_CACHE_SZ) {
+            hashtbl_destroy(cache);
+            cache = hashtbl_init((free_func_t)statement_destroy, NULL);
+            cached = 1;
+          }
+          hashtbl_insert(cache, key, st);
+        }
+      }
+
+      long double r = 0.0;
+      if (!st || regvm_eval(st->prog, &r, vars) != 0)
+        err = 1;
+      else if (st->var) {
+        long double *d = (long double*)zmalloc(sizeof(long double));
+        *d = r;
+        hashtbl_insert(vars, st->var, d);
+      } else
+        printf("%.15Lg\n", r);
+
+      /* skip whatever a failed compilation left behind */
+      while (lexer_current(l) != end)
+        lexer_advance(l);
+    }
+    lexer_consume(l);
+  } while (!eof);
+
+  free(key);
+  hashtbl_destroy(cache);
+  lexer_destroy(l);
+  scanner_destroy(s);
+  return err;
+}
+
+
 int main(int argc, char *argv[]) {
-  int ret = 0, interactive = 0;
+  int ret = 0, interactive = 0, batch = 0;
 
   /* parse command line */
-  while ((ret = getopt(argc, argv, "hi")) != -1) {
+  while ((ret = getopt(argc, argv, "hib")) != -1) {
     switch (ret) {
       case 'h':
-        fprintf(stderr, "usage: aparser {-i | <expresion>}\n");
+        fprintf(stderr, "usage: aparser {-i | -b [file] | <expresion>}\n");
         return 0;
         break;
       case 'i':
         interactive = 1;
         break;
+      case 'b':
+        batch = 1;
+        break;
       default:
         return 1;
     }
@@ -123,6 +246,10 @@ int main(int argc, char *argv[]) {
     printf("\n");
     write_history(histfile);
 
+  } else if (batch) {
+    setvbuf(stdout, NULL, _IOFBF, 1 << 16);
+    ret = parse_batch(optind < argc ? argv[optind] : "-");
+
   } else while (optind < argc) {
     printf("%.15Lg\n", parser_qeval(argv[optind++]));
   }
@@ -12,7 +12,7 @@ int main(int argc, char *argv[]) {
   char *x0 = NULL, *x1 = NULL;
   char *epsilon = EPSILON, *func = NULL;
   char *max_iter = MAXITER, *method = "secant";
-  long double r;
+  root_result_t r;
 
   /* parse command line */
   while ((ret = getopt(argc, argv, "vm:e:i:a:b:")) != -1) {
@@ -48,6 +48,10 @@ int main(int argc, char *argv[]) {
   }
 
   function_t *f = function_create(func);
+  if (!f) {
+    fprintf(stderr, "can't compile function: %s\n", func);
+    return 1;
+  }
   interval_t *i = interval_create(atof(x0), x1 ? atof(x1) : (atof(x0) + 1.0));
   stop_cond_t *s = stop_cond_create(atof(epsilon), atoi(max_iter));
 
@@ -57,17 +61,39 @@ int main(int argc, char *argv[]) {
     ret = root_bisection(f, i, s, &r);
   else if (!strcmp(method, "regulafalsi"))
     ret = root_regulafalsi(f, i, s, &r);
+  else if (!strcmp(method, "brent"))
+    ret = root_brent(f, i, s, &r);
   else if (!strcmp(method, "newton"))
     ret = root_newton(f, atof(x0), s, &r);
-  else {
+  else if (!strcmp(method, "scan")) {
+    /* every root in [x0, x1], one per line */
+    long double *roots = NULL;
+    ssize_t j, n = root_scan(f, i, s, 0, &roots);
+    for (j = 0; j < n; j++)
+      printf("%.15Lg\n", roots[j]);
+    free(roots);
+    ret = n < 0;
+  } else if (!strcmp(method, "poly")) {
+    /* every complex root of a polynomial, one per line */
+    long double complex *roots = NULL;
+    ssize_t j, n = root_polynomial_function(f, s, &roots);
+    for (j = 0; j < n; j++)
+      printf("%.15Lg %+.15Lgi\n", creall(roots[j]), cimagl(roots[j]));
+    free(roots);
+    ret = n < 0;
+  } else {
     fprintf(stderr, "Method not recognized: %s\n", method);
     return 1;
   }
 
   if (ret) {
     fprintf(stderr, "%s method failed (ret: %d)\n", method, ret);
-  } else {
-    printf("%.15Lg\n", r);
+  } else if (strcmp(method, "scan") && strcmp(method, "poly")) {
+    printf("%.15Lg\n", r.root);
+    if (root_search_verbose)
+      fprintf(stderr, "%s after %zu iterations (%zu evaluations): f(x)=%.15Lg width=%.15Lg\n",
+              r.reason == rootConverged ? "converged" : "out of iterations",
+              r.iterations, r.evals, r.residual, r.width);
   }
 
   function_destroy(f);